@@ -0,0 +1,504 @@
+/**
+ * @file uheap_bench.cpp
+ * @author Dmitry Donskikh (deedonskihdev@gmail.com)
+ * @brief uHeap against the system malloc on typical allocation workloads
+ * @version 0.1
+ * @date 2021-10-09
+ *
+ * Copyright (c) 2018-2021 Dmitriy Donskikh
+ * All rights reserved.
+ *
+ * Usage: uheap_bench [--threads N] [--ops N] [--format table|csv|json]
+ *                    [--workload NAME] [--allocator uheap|malloc]
+ * Workloads:
+ *  - churn     fixed-size (64 bytes) replacement of random slots
+ *  - random    random-size (16..4096 bytes) replacement of random slots
+ *  - prodcons  blocks allocated by producers and freed by consumer threads
+ *  - larson    random-size churn with slots passed to the next thread every round
+ *  - realloc   interleaved vectors growing by realloc up to 64 KB
+ * Every run of uHeap gets a fresh heap over an untouched region. Latency is sampled on
+ * every SAMPLE_PERIOD-th operation, live/footprint are taken when all slots are full.
+ */
+
+#include <heap/uheap.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    constexpr unsigned SAMPLE_PERIOD = 8;
+    constexpr size_t SLOT_COUNT = 1024;
+    constexpr unsigned LARSON_ROUNDS = 8;
+    constexpr size_t REGION_SIZE = UHEAP_MAX_HEAP_SIZE;
+
+    struct Options
+    {
+        unsigned max_threads;
+        unsigned ops;
+        std::string format = "table";
+        std::string workload;
+        std::string allocator;
+    };
+
+    struct Result
+    {
+        double mops;
+        double p50;
+        double p99;
+        double p999;
+        double max;
+        size_t live;
+        size_t footprint;
+        size_t rss;
+    };
+
+    /* Allocators */
+
+    uint8_t* g_region = nullptr;
+    ufw::uHeap* g_heap = nullptr;
+
+    struct SystemMalloc
+    {
+        static constexpr const char* name = "malloc";
+        static std::string label() { return name; }
+        static void* allocate(size_t size) { return malloc(size); }
+        static void deallocate(void* pv) { free(pv); }
+        static void* reallocate(void* pv, size_t size) { return realloc(pv, size); }
+        static void begin() {}
+        static size_t footprint()
+        {
+            struct mallinfo2 info = mallinfo2();
+            return info.arena + info.hblkhd;
+        }
+        static void end() { malloc_trim(0); }
+    };
+
+    struct UHeap
+    {
+        static constexpr const char* name = "uheap";
+        /* Builds with another UHEAP_PLACEMENT_POLICY are told apart by the label */
+        static std::string label() { return std::string(name) + "/" + UHEAP_PLACEMENT_POLICY::name; }
+        static void* allocate(size_t size) { return g_heap->allocate(size); }
+        static void deallocate(void* pv) { g_heap->deallocate(pv); }
+        static void* reallocate(void* pv, size_t size) { return g_heap->reallocate(pv, size); }
+        static void begin()
+        {
+            madvise(g_region, REGION_SIZE, MADV_DONTNEED);
+            g_heap = new ufw::uHeap(g_region, REGION_SIZE);
+        }
+        static size_t footprint() { return g_heap->capacity() - g_heap->getMemoryLowWatermark(); }
+        static void end()
+        {
+            delete g_heap;
+            g_heap = nullptr;
+        }
+    };
+
+    /* Helpers */
+
+    struct Random
+    {
+        uint64_t state;
+        explicit Random(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+        uint32_t next()
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return static_cast<uint32_t>(state >> 16);
+        }
+        /* Log-uniform size in [min, max) */
+        size_t size(size_t min_log2, size_t max_log2)
+        {
+            size_t base = (size_t)1 << (min_log2 + next() % (max_log2 - min_log2));
+            return base + next() % base;
+        }
+    };
+
+    size_t residentBytes()
+    {
+        long pages = 0, resident = 0;
+        FILE* f = fopen("/proc/self/statm", "r");
+        if (f == nullptr) { return 0; }
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2) { resident = 0; }
+        fclose(f);
+        return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    class Barrier
+    {
+       public:
+        explicit Barrier(unsigned count) : m_count(count) {}
+        void wait()
+        {
+            unsigned generation = m_generation.load();
+            if (m_arrived.fetch_add(1) + 1 == m_count)
+            {
+                m_arrived.store(0);
+                m_generation.fetch_add(1);
+                return;
+            }
+            while (m_generation.load() == generation) std::this_thread::yield();
+        }
+
+       private:
+        const unsigned m_count;
+        std::atomic<unsigned> m_arrived{0};
+        std::atomic<unsigned> m_generation{0};
+    };
+
+    /* Per-thread state of a run */
+    struct Worker
+    {
+        std::vector<uint32_t> samples;
+        size_t live = 0;
+        uint64_t ops = 0;
+        bench_clock::time_point begin;
+        bench_clock::time_point end;
+    };
+
+    /* Wait until the main thread has measured the memory in use */
+    void hold(Worker& w, Barrier& peak)
+    {
+        w.end = bench_clock::now();
+        peak.wait();
+        peak.wait();
+    }
+
+    template <typename F>
+    inline void* timed(Worker& w, uint64_t i, F&& op)
+    {
+        if ((i % SAMPLE_PERIOD) != 0) { return op(); }
+        auto start = bench_clock::now();
+        void* pv = op();
+        auto stop = bench_clock::now();
+        w.samples.push_back(
+            static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+        return pv;
+    }
+
+    /* Workloads. Every one runs the measured part, waits on `peak` with all of its
+     memory live and frees everything after it */
+
+    template <typename Alloc>
+    void churn(Worker& w, unsigned t, unsigned ops, Barrier& peak, bool random_size)
+    {
+        Random rnd(t + 1);
+        std::vector<void*> slots(SLOT_COUNT, nullptr);
+        std::vector<size_t> sizes(SLOT_COUNT, 0);
+        for (uint64_t i = 0; i < ops; ++i)
+        {
+            size_t slot = rnd.next() % SLOT_COUNT;
+            size_t size = random_size ? rnd.size(4, 12) : 64;
+            timed(w, i, [&] {
+                Alloc::deallocate(slots[slot]);
+                return slots[slot] = Alloc::allocate(size);
+            });
+            if (slots[slot] != nullptr) { memset(slots[slot], 0, 8); }
+            w.live += size - sizes[slot];
+            sizes[slot] = size;
+        }
+        w.ops = ops;
+        hold(w, peak);
+        for (void* pv : slots) Alloc::deallocate(pv);
+    }
+
+    struct SpscQueue
+    {
+        static constexpr size_t CAPACITY = 1024;
+        void* items[CAPACITY];
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+
+        bool push(void* pv)
+        {
+            size_t t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) == CAPACITY) { return false; }
+            items[t % CAPACITY] = pv;
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+        bool pop(void*& pv)
+        {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire)) { return false; }
+            pv = items[h % CAPACITY];
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+    };
+
+    template <typename Alloc>
+    void prodcons(Worker& w, unsigned t, unsigned ops, Barrier& peak, SpscQueue& queue)
+    {
+        Random rnd(t + 1);
+        const bool producer = (t % 2) == 0;
+        for (uint64_t i = 0; i < ops; ++i)
+        {
+            if (producer)
+            {
+                void* pv = timed(w, i, [&] { return Alloc::allocate(rnd.size(4, 9)); });
+                while (!queue.push(pv)) std::this_thread::yield();
+            } else
+            {
+                void* pv = nullptr;
+                while (!queue.pop(pv)) std::this_thread::yield();
+                timed(w, i, [&] {
+                    Alloc::deallocate(pv);
+                    return nullptr;
+                });
+            }
+        }
+        w.ops = ops;
+        hold(w, peak);
+    }
+
+    struct Slot
+    {
+        void* pv = nullptr;
+        size_t size = 0;
+    };
+
+    template <typename Alloc>
+    void larson(Worker& w, unsigned t, unsigned threads, unsigned ops, Barrier& peak, Barrier& round,
+                std::vector<std::vector<Slot>>& slots)
+    {
+        Random rnd(t + 1);
+        const unsigned round_ops = ops / LARSON_ROUNDS;
+        uint64_t i = 0;
+        for (unsigned r = 0; r < LARSON_ROUNDS; ++r)
+        {
+            /* Slots of the previous owner, blocks are freed by another thread */
+            auto& own = slots[(t + r) % threads];
+            for (unsigned k = 0; k < round_ops; ++k, ++i)
+            {
+                size_t slot = rnd.next() % SLOT_COUNT;
+                size_t size = rnd.size(4, 9);
+                timed(w, i, [&] {
+                    Alloc::deallocate(own[slot].pv);
+                    return own[slot].pv = Alloc::allocate(size);
+                });
+                /* Sizes freed here were counted by another thread, only the sum is right */
+                w.live += size - own[slot].size;
+                own[slot].size = size;
+            }
+            round.wait();
+        }
+        w.ops = i;
+        hold(w, peak);
+        for (Slot& slot : slots[t]) Alloc::deallocate(slot.pv);
+    }
+
+    template <typename Alloc>
+    void growth(Worker& w, unsigned t, unsigned ops, Barrier& peak)
+    {
+        (void)t;
+        constexpr size_t VECTORS = 4;
+        constexpr size_t MAX_SIZE = 64 * 1024;
+        void* vectors[VECTORS] = {};
+        size_t sizes[VECTORS] = {};
+        for (uint64_t i = 0; i < ops; ++i)
+        {
+            size_t v = i % VECTORS;
+            size_t size = sizes[v] + sizes[v] / 2 + 16;
+            if (size > MAX_SIZE)
+            {
+                Alloc::deallocate(vectors[v]);
+                vectors[v] = nullptr;
+                w.live -= sizes[v];
+                sizes[v] = 0;
+                continue;
+            }
+            void* pv = timed(w, i, [&] { return Alloc::reallocate(vectors[v], size); });
+            if (pv == nullptr) { continue; }
+            vectors[v] = pv;
+            w.live += size - sizes[v];
+            sizes[v] = size;
+        }
+        w.ops = ops;
+        hold(w, peak);
+        for (void* pv : vectors) Alloc::deallocate(pv);
+    }
+
+    template <typename Alloc>
+    Result run(const std::string& workload, unsigned threads, unsigned ops)
+    {
+        Alloc::begin();
+        const size_t rss_before = residentBytes();
+        std::vector<Worker> workers(threads);
+        for (auto& w : workers) w.samples.reserve(ops / SAMPLE_PERIOD + 1);
+        std::vector<SpscQueue> queues((threads + 1) / 2);
+        std::vector<std::vector<Slot>> larson_slots(threads, std::vector<Slot>(SLOT_COUNT));
+        Barrier start(threads + 1), peak(threads + 1), round(threads);
+
+        std::vector<std::thread> pool;
+        for (unsigned t = 0; t < threads; ++t)
+        {
+            pool.emplace_back([&, t] {
+                Worker& w = workers[t];
+                start.wait();
+                w.begin = bench_clock::now();
+                if (workload == "churn") churn<Alloc>(w, t, ops, peak, false);
+                if (workload == "random") churn<Alloc>(w, t, ops, peak, true);
+                if (workload == "prodcons") prodcons<Alloc>(w, t, ops, peak, queues[t / 2]);
+                if (workload == "larson") larson<Alloc>(w, t, threads, ops, peak, round, larson_slots);
+                if (workload == "realloc") growth<Alloc>(w, t, ops, peak);
+            });
+        }
+        start.wait();
+        /* All threads are done and hold their memory */
+        peak.wait();
+        Result r{};
+        r.footprint = Alloc::footprint();
+        const size_t rss_peak = residentBytes();
+        r.rss = (rss_peak > rss_before) ? (rss_peak - rss_before) : 0;
+        uint64_t total_ops = 0;
+        for (auto& w : workers)
+        {
+            r.live += w.live;
+            total_ops += w.ops;
+        }
+        peak.wait();
+        for (auto& th : pool) th.join();
+        Alloc::end();
+
+        std::vector<uint32_t> all;
+        for (auto& w : workers) all.insert(all.end(), w.samples.begin(), w.samples.end());
+        std::sort(all.begin(), all.end());
+        auto pct = [&](double p) {
+            return all.empty() ? 0.0 : static_cast<double>(all[static_cast<size_t>(p * (all.size() - 1))]);
+        };
+        auto begin = workers[0].begin;
+        auto end = workers[0].end;
+        for (auto& w : workers)
+        {
+            begin = std::min(begin, w.begin);
+            end = std::max(end, w.end);
+        }
+        r.mops = static_cast<double>(total_ops) / std::chrono::duration<double>(end - begin).count() / 1e6;
+        r.p50 = pct(0.5);
+        r.p99 = pct(0.99);
+        r.p999 = pct(0.999);
+        r.max = pct(1.0);
+        return r;
+    }
+
+    /* Output */
+
+    bool g_first_row = true;
+
+    void header(const Options& opt)
+    {
+        if (opt.format == "csv")
+        {
+            printf("allocator,workload,threads,mops,p50_ns,p99_ns,p999_ns,max_ns,live_kb,footprint_kb,"
+                   "fragmentation,rss_kb,peak_rss_kb\n");
+        } else if (opt.format == "json")
+        {
+            printf("[\n");
+        } else
+        {
+            printf("%-18s %-9s %7s %9s %8s %8s %8s %9s %10s %12s %6s %10s %12s\n", "alloc", "workload", "threads",
+                   "Mops/s", "p50(ns)", "p99(ns)", "p99.9", "max(ns)", "live(KB)", "footprint", "frag",
+                   "rss(KB)", "peak_rss(KB)");
+        }
+    }
+
+    void row(const Options& opt, const char* alloc, const std::string& workload, unsigned threads,
+             const Result& r)
+    {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        /* Nothing is live at the end of producer/consumer runs */
+        const double frag =
+            ((r.live != 0) && (r.footprint > r.live)) ? 1.0 - static_cast<double>(r.live) / r.footprint : 0.0;
+        if (opt.format == "csv")
+        {
+            printf("%s,%s,%u,%.3f,%.0f,%.0f,%.0f,%.0f,%zu,%zu,%.3f,%zu,%ld\n", alloc, workload.c_str(), threads,
+                   r.mops, r.p50, r.p99, r.p999, r.max, r.live / 1024, r.footprint / 1024, frag, r.rss / 1024,
+                   usage.ru_maxrss);
+        } else if (opt.format == "json")
+        {
+            printf("%s  {\"allocator\": \"%s\", \"workload\": \"%s\", \"threads\": %u, \"mops\": %.3f, "
+                   "\"p50_ns\": %.0f, \"p99_ns\": %.0f, \"p999_ns\": %.0f, \"max_ns\": %.0f, \"live_kb\": %zu, "
+                   "\"footprint_kb\": %zu, \"fragmentation\": %.3f, \"rss_kb\": %zu, \"peak_rss_kb\": %ld}",
+                   g_first_row ? "" : ",\n", alloc, workload.c_str(), threads, r.mops, r.p50, r.p99, r.p999,
+                   r.max, r.live / 1024, r.footprint / 1024, frag, r.rss / 1024, usage.ru_maxrss);
+        } else
+        {
+            printf("%-18s %-9s %7u %9.2f %8.0f %8.0f %8.0f %9.0f %10zu %12zu %6.3f %10zu %12ld\n", alloc,
+                   workload.c_str(), threads, r.mops, r.p50, r.p99, r.p999, r.max, r.live / 1024,
+                   r.footprint / 1024, frag, r.rss / 1024, usage.ru_maxrss);
+        }
+        g_first_row = false;
+        fflush(stdout);
+    }
+
+    template <typename Alloc>
+    void bench(const Options& opt, const std::string& workload)
+    {
+        if (!opt.allocator.empty() && (opt.allocator != Alloc::name)) { return; }
+        /* Producer/consumer needs pairs of threads */
+        const unsigned min_threads = (workload == "prodcons") ? 2 : 1;
+        for (unsigned threads = min_threads; threads <= std::max(opt.max_threads, min_threads); threads <<= 1)
+        {
+            row(opt, Alloc::label().c_str(), workload, threads, run<Alloc>(workload, threads, opt.ops));
+        }
+    }
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    opt.max_threads = std::max(1u, std::thread::hardware_concurrency());
+    opt.ops = 200000;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string key = argv[i];
+        if (key == "--threads") opt.max_threads = static_cast<unsigned>(atoi(argv[i + 1]));
+        else if (key == "--ops") opt.ops = static_cast<unsigned>(atoi(argv[i + 1]));
+        else if (key == "--format") opt.format = argv[i + 1];
+        else if (key == "--workload") opt.workload = argv[i + 1];
+        else if (key == "--allocator") opt.allocator = argv[i + 1];
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    g_region = static_cast<uint8_t*>(
+        mmap(nullptr, REGION_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+    if (g_region == MAP_FAILED)
+    {
+        fprintf(stderr, "can't map %zu bytes for the heap\n", REGION_SIZE);
+        return 1;
+    }
+
+    header(opt);
+    for (const char* workload : {"churn", "random", "prodcons", "larson", "realloc"})
+    {
+        if (!opt.workload.empty() && (opt.workload != workload)) { continue; }
+        bench<UHeap>(opt, workload);
+        bench<SystemMalloc>(opt, workload);
+    }
+    if (opt.format == "json") { printf("\n]\n"); }
+    munmap(g_region, REGION_SIZE);
+    return 0;
+}
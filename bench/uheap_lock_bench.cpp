@@ -0,0 +1,120 @@
+/**
+ * @file uheap_lock_bench.cpp
+ * @author Dmitry Donskikh (deedonskihdev@gmail.com)
+ * @brief Latency and throughput of uHeap locks across thread counts
+ * @version 0.1
+ * @date 2021-09-20
+ *
+ * Copyright (c) 2018-2021 Dmitriy Donskikh
+ * All rights reserved.
+ *
+ * Usage: uheap_lock_bench [max_threads] [ops_per_thread]
+ * Every thread acquires the lock, does a short critical section (similar to a heap
+ * free-list update) and some work outside of the lock. Acquire latency is sampled
+ * on every 16-th operation.
+ */
+
+#include <heap/uheap_locks.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    constexpr unsigned SAMPLE_PERIOD = 16;
+
+    struct Result
+    {
+        double mops;
+        double p50;
+        double p99;
+        double max;
+    };
+
+    volatile uint64_t g_shared[8];
+
+    template <typename Lock>
+    Result run(unsigned threads, unsigned ops)
+    {
+        Lock lock;
+        std::vector<std::vector<uint32_t>> samples(threads);
+        std::vector<std::thread> workers;
+        std::atomic<unsigned> ready{0};
+        std::atomic<bool> go{false};
+
+        for (unsigned t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t] {
+                auto& local = samples[t];
+                local.reserve(ops / SAMPLE_PERIOD + 1);
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                uint64_t seed = t + 1;
+                for (unsigned i = 0; i < ops; ++i)
+                {
+                    if ((i % SAMPLE_PERIOD) == 0)
+                    {
+                        auto start = bench_clock::now();
+                        lock.lock();
+                        auto stop = bench_clock::now();
+                        local.push_back(static_cast<uint32_t>(
+                            std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+                    } else
+                    {
+                        lock.lock();
+                    }
+                    for (auto& v : g_shared) v = v + 1;
+                    lock.unlock();
+                    /* Work outside of the critical section */
+                    for (unsigned k = 0; k < 32; ++k) seed = seed * 6364136223846793005ULL + 1;
+                }
+                g_shared[0] = g_shared[0] + (seed & 1);
+            });
+        }
+        while (ready.load() != threads) std::this_thread::yield();
+        auto start = bench_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& w : workers) w.join();
+        double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+        std::vector<uint32_t> all;
+        for (auto& s : samples) all.insert(all.end(), s.begin(), s.end());
+        std::sort(all.begin(), all.end());
+        auto pct = [&](double p) { return static_cast<double>(all[static_cast<size_t>(p * (all.size() - 1))]); };
+        return {(static_cast<double>(threads) * ops) / seconds / 1e6, pct(0.5), pct(0.99),
+                static_cast<double>(all.back())};
+    }
+
+    template <typename Lock>
+    void bench(const char* name, unsigned max_threads, unsigned ops)
+    {
+        for (unsigned threads = 1; threads <= max_threads; threads <<= 1)
+        {
+            Result r = run<Lock>(threads, ops);
+            printf("%-12s %7u %10.2f %10.0f %10.0f %12.0f\n", name, threads, r.mops, r.p50, r.p99, r.max);
+        }
+    }
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    unsigned max_threads = (argc > 1) ? static_cast<unsigned>(atoi(argv[1]))
+                                      : std::max(2u, std::thread::hardware_concurrency() * 2);
+    unsigned ops = (argc > 2) ? static_cast<unsigned>(atoi(argv[2])) : 200000;
+
+    printf("%-12s %7s %10s %10s %10s %12s\n", "lock", "threads", "Mops/s", "p50(ns)", "p99(ns)", "max(ns)");
+    bench<ufw::uSpinLock>("uSpinLock", max_threads, ops);
+    bench<ufw::uTicketLock>("uTicketLock", max_threads, ops);
+#ifdef __linux__
+    bench<ufw::uFutexLock>("uFutexLock", max_threads, ops);
+#endif
+    bench<std::mutex>("std::mutex", max_threads, ops);
+    return 0;
+}
@@ -0,0 +1,317 @@
+/**
+ * @file uheap_replay.cpp
+ * @author Dmitry Donskikh (deedonskihdev@gmail.com)
+ * @brief Replays a trace recorded with UHEAP_TRACE against uHeap and the system malloc
+ * @version 0.1
+ * @date 2021-10-14
+ *
+ * Copyright (c) 2018-2021 Dmitriy Donskikh
+ * All rights reserved.
+ *
+ * Usage: uheap_replay TRACE [--allocator uheap|malloc] [--format table|csv]
+ * Events are sorted by timestamp and replayed from one thread, so the order of
+ * cross-thread frees is kept. Every call is timed, throughput counts only the time
+ * spent in the allocator. Live bytes are the requested sizes, footprint is the memory
+ * held by the allocator above the one held before the replay (the used high-water mark
+ * for uHeap), fragmentation is 1 - peak live/peak footprint. Footprint is sampled every
+ * SAMPLE_PERIOD events.
+ * Free space fragmentation (1 - largest free block / free bytes) is reported for uHeap.
+ */
+
+#include <heap/uheap.h>
+#include <heap/uheap_trace.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <malloc.h>
+#include <sys/mman.h>
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    constexpr size_t SAMPLE_PERIOD = 1024;
+    constexpr size_t REGION_SIZE = UHEAP_MAX_HEAP_SIZE;
+
+    uint8_t* g_region = nullptr;
+    ufw::uHeap* g_heap = nullptr;
+
+    struct SystemMalloc
+    {
+        static constexpr const char* name = "malloc";
+        static std::string label() { return name; }
+        static void* allocate(size_t size) { return malloc(size); }
+        static void deallocate(void* pv) { free(pv); }
+        static void* reallocate(void* pv, size_t size) { return realloc(pv, size); }
+        static void begin() {}
+        static size_t footprint()
+        {
+            struct mallinfo2 info = mallinfo2();
+            return info.arena + info.hblkhd;
+        }
+        static double freeFragmentation() { return 0.0; }
+        static void end() { malloc_trim(0); }
+    };
+
+    struct UHeap
+    {
+        static constexpr const char* name = "uheap";
+        /* Builds with another UHEAP_PLACEMENT_POLICY are told apart by the label */
+        static std::string label() { return std::string(name) + "/" + UHEAP_PLACEMENT_POLICY::name; }
+        static void* allocate(size_t size) { return g_heap->allocate(size); }
+        static void deallocate(void* pv) { g_heap->deallocate(pv); }
+        static void* reallocate(void* pv, size_t size) { return g_heap->reallocate(pv, size); }
+        static void begin()
+        {
+            madvise(g_region, REGION_SIZE, MADV_DONTNEED);
+            g_heap = new ufw::uHeap(g_region, REGION_SIZE);
+        }
+        static size_t footprint() { return g_heap->capacity() - g_heap->getMemoryLowWatermark(); }
+        static double freeFragmentation() { return g_heap->stats().fragmentation(); }
+        static void end()
+        {
+            delete g_heap;
+            g_heap = nullptr;
+        }
+    };
+
+    struct Result
+    {
+        size_t ops = 0;
+        size_t failed = 0;
+        size_t unknown = 0;
+        double p50 = 0, p99 = 0, p999 = 0, max = 0;
+        double seconds = 0;
+        size_t peak_live = 0;
+        size_t peak_footprint = 0;
+        double fragmentation = 0;
+        double peak_free_fragmentation = 0;
+    };
+
+    bool load(const char* path, std::vector<ufw::uTraceEvent>& events)
+    {
+        FILE* f = fopen(path, "rb");
+        if (f == nullptr)
+        {
+            fprintf(stderr, "can't open %s\n", path);
+            return false;
+        }
+        ufw::uTraceHeader header{};
+        if ((fread(&header, sizeof(header), 1, f) != 1) || (header.magic != ufw::UHEAP_TRACE_MAGIC) ||
+            (header.version != ufw::UHEAP_TRACE_VERSION) || (header.eventSize != sizeof(ufw::uTraceEvent)))
+        {
+            fprintf(stderr, "%s is not a uHeap trace of version %u (or has another byte order)\n", path,
+                    ufw::UHEAP_TRACE_VERSION);
+            fclose(f);
+            return false;
+        }
+        ufw::uTraceEvent event;
+        while (fread(&event, sizeof(event), 1, f) == 1) events.push_back(event);
+        fclose(f);
+        std::stable_sort(events.begin(), events.end(),
+                         [](const ufw::uTraceEvent& a, const ufw::uTraceEvent& b) { return a.timestamp < b.timestamp; });
+        return true;
+    }
+
+    template <typename Alloc>
+    Result replay(const std::vector<ufw::uTraceEvent>& events)
+    {
+        struct Block
+        {
+            void* pv;
+            size_t size;
+        };
+        std::unordered_map<uint64_t, Block> live;
+        live.reserve(events.size());
+        std::vector<uint32_t> samples;
+        samples.reserve(events.size());
+        Result r;
+        size_t live_bytes = 0;
+
+        Alloc::begin();
+        const size_t base_footprint = Alloc::footprint();
+        auto timed = [&](auto&& op) {
+            auto start = bench_clock::now();
+            void* pv = op();
+            auto stop = bench_clock::now();
+            samples.push_back(
+                static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+            return pv;
+        };
+        auto forget = [&](uint64_t id) {
+            auto it = live.find(id);
+            if (it == live.end()) { return; }
+            live_bytes -= it->second.size;
+            live.erase(it);
+        };
+
+        for (size_t i = 0; i < events.size(); ++i)
+        {
+            const ufw::uTraceEvent& e = events[i];
+            switch (static_cast<ufw::uTraceOp>(e.op))
+            {
+                case ufw::uTraceOp::allocate:
+                {
+                    /* The free of the previous block with this address was dropped */
+                    auto it = live.find(e.pointer);
+                    if (it != live.end())
+                    {
+                        Alloc::deallocate(it->second.pv);
+                        forget(e.pointer);
+                    }
+                    void* pv = timed([&] { return Alloc::allocate(e.size); });
+                    if (pv == nullptr)
+                    {
+                        ++r.failed;
+                        break;
+                    }
+                    live[e.pointer] = {pv, e.size};
+                    live_bytes += e.size;
+                    break;
+                }
+                case ufw::uTraceOp::deallocate:
+                {
+                    auto it = live.find(e.pointer);
+                    if (it == live.end())
+                    {
+                        ++r.unknown;
+                        break;
+                    }
+                    void* pv = it->second.pv;
+                    timed([&] {
+                        Alloc::deallocate(pv);
+                        return nullptr;
+                    });
+                    forget(e.pointer);
+                    break;
+                }
+                case ufw::uTraceOp::reallocate:
+                {
+                    auto it = live.find(e.previous);
+                    void* old = nullptr;
+                    if (it == live.end())
+                    {
+                        ++r.unknown;
+                    } else
+                    {
+                        old = it->second.pv;
+                    }
+                    void* pv = timed([&] { return Alloc::reallocate(old, e.size); });
+                    if (pv == nullptr)
+                    {
+                        ++r.failed;
+                        break;
+                    }
+                    forget(e.previous);
+                    live[e.pointer] = {pv, e.size};
+                    live_bytes += e.size;
+                    break;
+                }
+                default:
+                    ++r.unknown;
+                    continue;
+            }
+            r.peak_live = std::max(r.peak_live, live_bytes);
+            if ((i % SAMPLE_PERIOD) == 0)
+            {
+                size_t footprint = Alloc::footprint();
+                footprint = (footprint > base_footprint) ? (footprint - base_footprint) : 0;
+                r.peak_footprint = std::max(r.peak_footprint, footprint);
+                r.peak_free_fragmentation = std::max(r.peak_free_fragmentation, Alloc::freeFragmentation());
+            }
+        }
+        for (auto& block : live) Alloc::deallocate(block.second.pv);
+        Alloc::end();
+
+        if (r.peak_footprint > r.peak_live)
+        {
+            r.fragmentation = 1.0 - static_cast<double>(r.peak_live) / r.peak_footprint;
+        }
+        r.ops = samples.size();
+        uint64_t total = 0;
+        for (uint32_t s : samples) total += s;
+        r.seconds = static_cast<double>(total) / 1e9;
+        std::sort(samples.begin(), samples.end());
+        auto pct = [&](double p) {
+            return samples.empty() ? 0.0 : static_cast<double>(samples[static_cast<size_t>(p * (samples.size() - 1))]);
+        };
+        r.p50 = pct(0.5);
+        r.p99 = pct(0.99);
+        r.p999 = pct(0.999);
+        r.max = pct(1.0);
+        return r;
+    }
+
+    void row(bool csv, const char* alloc, const Result& r)
+    {
+        const double mops = (r.seconds > 0) ? static_cast<double>(r.ops) / r.seconds / 1e6 : 0.0;
+        if (csv)
+        {
+            printf("%s,%zu,%zu,%zu,%.3f,%.0f,%.0f,%.0f,%.0f,%zu,%zu,%.3f,%.3f\n", alloc, r.ops, r.failed, r.unknown,
+                   mops, r.p50, r.p99, r.p999, r.max, r.peak_live / 1024, r.peak_footprint / 1024,
+                   r.fragmentation, r.peak_free_fragmentation);
+        } else
+        {
+            printf("%-18s %10zu %7zu %8zu %9.2f %8.0f %8.0f %8.0f %9.0f %10zu %12zu %6.3f %9.3f\n", alloc, r.ops,
+                   r.failed, r.unknown, mops, r.p50, r.p99, r.p999, r.max, r.peak_live / 1024,
+                   r.peak_footprint / 1024, r.fragmentation, r.peak_free_fragmentation);
+        }
+    }
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s TRACE [--allocator uheap|malloc] [--format table|csv]\n", argv[0]);
+        return 1;
+    }
+    std::string allocator, format = "table";
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        std::string key = argv[i];
+        if (key == "--allocator") allocator = argv[i + 1];
+        else if (key == "--format") format = argv[i + 1];
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    std::vector<ufw::uTraceEvent> events;
+    if (!load(argv[1], events)) { return 1; }
+
+    g_region = static_cast<uint8_t*>(
+        mmap(nullptr, REGION_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+    if (g_region == MAP_FAILED)
+    {
+        fprintf(stderr, "can't map %zu bytes for the heap\n", REGION_SIZE);
+        return 1;
+    }
+
+    const bool csv = (format == "csv");
+    if (csv)
+    {
+        printf("allocator,ops,failed,unknown,mops,p50_ns,p99_ns,p999_ns,max_ns,peak_live_kb,peak_footprint_kb,"
+               "fragmentation,peak_free_fragmentation\n");
+    } else
+    {
+        printf("%zu events\n%-18s %10s %7s %8s %9s %8s %8s %8s %9s %10s %12s %6s %9s\n", events.size(), "alloc", "ops",
+               "failed", "unknown", "Mops/s", "p50(ns)", "p99(ns)", "p99.9", "max(ns)", "live(KB)", "footprint",
+               "frag", "free_frag");
+    }
+    if (allocator.empty() || (allocator == UHeap::name)) { row(csv, UHeap::label().c_str(), replay<UHeap>(events)); }
+    if (allocator.empty() || (allocator == SystemMalloc::name))
+    {
+        row(csv, SystemMalloc::label().c_str(), replay<SystemMalloc>(events));
+    }
+    munmap(g_region, REGION_SIZE);
+    return 0;
+}
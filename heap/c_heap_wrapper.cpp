@@ -14,11 +14,51 @@ void* ufw_heap_alloc (size_t size)
   return ufw::uHeap::instance().allocate(size);
 }
 
+void* ufw_heap_alloc_aligned (size_t alignment, size_t size)
+{
+  return ufw::uHeap::instance().allocate_aligned(size, alignment);
+}
+
+void* ufw_heap_alloc_zeroed (size_t count, size_t size)
+{
+  return ufw::uHeap::instance().allocate_zeroed(count, size);
+}
+
 void ufw_heap_free (void *ptr)
 {
   ufw::uHeap::instance().deallocate(ptr);
 }
 
+void* ufw_heap_realloc (void *ptr, size_t size)
+{
+  return ufw::uHeap::instance().reallocate(ptr, size);
+}
+
+int ufw_heap_try_expand (void *ptr, size_t size)
+{
+  return ufw::uHeap::instance().try_expand(ptr, size) ? 1 : 0;
+}
+
+size_t ufw_heap_alloc_batch (size_t size, size_t count, void **ptrs)
+{
+  return ufw::uHeap::instance().allocate_batch(size, count, ptrs);
+}
+
+void ufw_heap_free_batch (void **ptrs, size_t count)
+{
+  ufw::uHeap::instance().deallocate_batch(ptrs, count);
+}
+
+size_t ufw_heap_usable_size (void *ptr)
+{
+  return ufw::uHeap::instance().usable_size(ptr);
+}
+
+size_t ufw_heap_trim ()
+{
+  return ufw::uHeap::instance().trim();
+}
+
 size_t ufw_heap_getfreebytes ()
 {
   return ufw::uHeap::instance().getFreeBytesRemaining();
@@ -24,12 +24,70 @@ extern "C" {
  * @param size
  */
 void* ufw_heap_alloc(size_t size);
+/**
+ * @fn void ufw_heap_alloc_aligned*(size_t, size_t)
+ * @brief C-wrapper for uHeap::allocate_aligned(size, alignment)
+ * @param alignment - power of two
+ * @param size
+ */
+void* ufw_heap_alloc_aligned(size_t alignment, size_t size);
+/**
+ * @fn void ufw_heap_alloc_zeroed*(size_t, size_t)
+ * @brief C-wrapper for uHeap::allocate_zeroed(count, size), calloc semantics
+ * @param count
+ * @param size
+ */
+void* ufw_heap_alloc_zeroed(size_t count, size_t size);
 /**
  * @fn void ufw_heap_free(void*)
  * @brief C-wrapper for uHeap::free(ptr)
  * @param ptr
  */
 void ufw_heap_free(void* ptr);
+/**
+ * @fn void ufw_heap_realloc*(void*, size_t)
+ * @brief C-wrapper for uHeap::reallocate(ptr, size)
+ * @param ptr
+ * @param size
+ */
+void* ufw_heap_realloc(void* ptr, size_t size);
+/**
+ * @fn int ufw_heap_try_expand(void*, size_t)
+ * @brief C-wrapper for uHeap::try_expand(ptr, size)
+ * @param ptr
+ * @param size
+ * @return non-zero if the block was resized in place
+ */
+int ufw_heap_try_expand(void* ptr, size_t size);
+/**
+ * @fn size_t ufw_heap_alloc_batch(size_t, size_t, void**)
+ * @brief C-wrapper for uHeap::allocate_batch(size, count, ptrs)
+ * @param size - size of every block
+ * @param count
+ * @param ptrs - array of at least count pointers
+ * @return number of allocated blocks
+ */
+size_t ufw_heap_alloc_batch(size_t size, size_t count, void** ptrs);
+/**
+ * @fn void ufw_heap_free_batch(void**, size_t)
+ * @brief C-wrapper for uHeap::deallocate_batch(ptrs, count), ptrs are reordered
+ * @param ptrs
+ * @param count
+ */
+void ufw_heap_free_batch(void** ptrs, size_t count);
+/**
+ * @fn size_t ufw_heap_usable_size(void*)
+ * @brief C-wrapper for uHeap::usable_size(ptr)
+ * @param ptr
+ * @return number of bytes the block can hold, 0 for NULL
+ */
+size_t ufw_heap_usable_size(void* ptr);
+/**
+ * @fn size_t ufw_heap_trim()
+ * @brief C-wrapper for uHeap::trim()
+ * @return number of bytes given back to the OS
+ */
+size_t ufw_heap_trim();
 /**
  * @fn size_t uheap_getfreebytes()
  * @brief C-wrapper for uHeap::getFreeBytes()
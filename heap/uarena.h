@@ -0,0 +1,280 @@
+/**
+ * @file uarena.h
+ * @author Dmitry Donskikh (deedonskihdev@gmail.com)
+ * @brief Monotonic (bump) arena on top of uHeap for request-scoped allocations
+ * @version 0.1
+ * @date 2021-10-05
+ *
+ * Copyright (c) 2018-2021 Dmitriy Donskikh
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include "uheap.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ufw
+{
+    /**
+     * @class uArena
+     * @brief Bump allocator. Takes big chunks from uHeap and allocates from them with
+     * pointer arithmetic, single objects are never freed. Savepoints (and uScope)
+     * roll the arena back to an earlier state, reset() rewinds it completely in O(1).
+     * Chunks are kept for reuse until release() or destruction.
+     * @tparam Lockable - "BasicLockable" lock, arenas are usually owned by one thread
+     */
+    template <typename Lockable = uNullLock>
+    class uArena
+    {
+       private:
+        struct uChunk
+        {
+            uChunk* next;
+            size_t size;
+
+            uint8_t* begin() { return reinterpret_cast<uint8_t*>(this) + CHUNK_HEADER_SIZE; }
+            uint8_t* end() { return begin() + size; }
+        };
+        static constexpr size_t CHUNK_HEADER_SIZE =
+            (sizeof(uChunk) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+       public:
+        /**
+         * @struct uMarker - saved state of the arena
+         */
+        struct uMarker
+        {
+            uChunk* chunk;
+            uint8_t* ptr;
+        };
+
+        /**
+         * @class uScope - RAII savepoint, rolls the arena back at scope exit
+         */
+        class uScope
+        {
+           private:
+            uArena& m_arena;
+            const uMarker m_marker;
+            uScope(const uScope&) = delete;
+            uScope& operator=(const uScope&) = delete;
+
+           public:
+            explicit uScope(uArena& arena) : m_arena(arena), m_marker(arena.savepoint()) {}
+            ~uScope() { m_arena.rollback(m_marker); }
+        };
+
+        /**
+         * @brief uArena - Constructor, no memory is taken until the first allocation
+         * @param heap - heap to take chunks from
+         * @param chunk_size - usable size of a chunk in bytes
+         */
+        explicit uArena(uHeap& heap = uHeap::instance(), size_t chunk_size = UHEAP_ARENA_CHUNK_SIZE)
+            : m_heap(heap), m_chunkSize(chunk_size)
+        {
+        }
+        ~uArena() { release(); }
+
+        /**
+         * @fn void allocate*(size_t, size_t)
+         * @brief Allocate number of bytes
+         * @param size
+         * @param alignment - power of two
+         * @return nullptr if the heap is full or the alignment isn't a power of two
+         */
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+        {
+            if ((alignment == 0) || ((alignment & (alignment - 1)) != 0)) { return nullptr; }
+            // LOCK (unlocked at scope exit)
+            uGuard alloc_guard(m_lock);
+            if (m_current != nullptr)
+            {
+                uint8_t* ptr = m_align(m_ptr, alignment);
+                if ((ptr <= m_current->end()) && (size <= static_cast<size_t>(m_current->end() - ptr)))
+                {
+                    m_ptr = ptr + size;
+                    return ptr;
+                }
+            }
+            return m_allocateSlow(size, alignment);
+        }
+
+        /**
+         * @fn uMarker savepoint()
+         * @brief Current state of the arena to roll back to
+         */
+        uMarker savepoint()
+        {
+            // LOCK (unlocked at scope exit)
+            uGuard savepoint_guard(m_lock);
+            return {m_current, m_ptr};
+        }
+
+        /**
+         * @fn void rollback(uMarker)
+         * @brief Free everything allocated after the savepoint, chunks are kept
+         */
+        void rollback(const uMarker& marker)
+        {
+            // LOCK (unlocked at scope exit)
+            uGuard rollback_guard(m_lock);
+            m_current = marker.chunk;
+            m_ptr = marker.ptr;
+            if (m_current == nullptr) { m_rewind(); }
+        }
+
+        /**
+         * @fn void reset()
+         * @brief Free everything allocated from the arena, chunks are kept
+         */
+        void reset()
+        {
+            // LOCK (unlocked at scope exit)
+            uGuard reset_guard(m_lock);
+            m_rewind();
+        }
+
+        /**
+         * @fn void release()
+         * @brief Free everything and return all chunks to the heap
+         */
+        void release()
+        {
+            // LOCK (unlocked at scope exit)
+            uGuard release_guard(m_lock);
+            while (m_chunks != nullptr)
+            {
+                uChunk* chunk = m_chunks;
+                m_chunks = chunk->next;
+                m_heap.deallocate(chunk);
+            }
+            m_current = nullptr;
+            m_ptr = nullptr;
+        }
+
+        /**
+         * @brief capacity - total size of chunks held by the arena
+         */
+        size_t capacity()
+        {
+            // LOCK (unlocked at scope exit)
+            uGuard capacity_guard(m_lock);
+            size_t total = 0;
+            for (uChunk* chunk = m_chunks; chunk != nullptr; chunk = chunk->next) total += chunk->size;
+            return total;
+        }
+
+       private:
+        uHeap& m_heap;
+        const size_t m_chunkSize;
+        /* Chunks in order of use, the ones after m_current are free */
+        uChunk* m_chunks = nullptr;
+        uChunk* m_current = nullptr;
+        uint8_t* m_ptr = nullptr;
+        Lockable m_lock{};
+
+        static uint8_t* m_align(uint8_t* ptr, size_t alignment)
+        {
+            return reinterpret_cast<uint8_t*>((reinterpret_cast<size_t>(ptr) + alignment - 1) & ~(alignment - 1));
+        }
+
+        void m_rewind()
+        {
+            m_current = m_chunks;
+            m_ptr = (m_chunks != nullptr) ? m_chunks->begin() : nullptr;
+        }
+
+        void* m_allocateSlow(size_t size, size_t alignment)
+        {
+            /* Try the chunks kept after the current one */
+            uChunk* chunk = (m_current != nullptr) ? m_current->next : m_chunks;
+            while (chunk != nullptr)
+            {
+                uint8_t* ptr = m_align(chunk->begin(), alignment);
+                if ((ptr <= chunk->end()) && (size <= static_cast<size_t>(chunk->end() - ptr)))
+                {
+                    /* Chunks skipped on the way stay behind the current one until the
+                     next rewind */
+                    m_current = chunk;
+                    m_ptr = ptr + size;
+                    return ptr;
+                }
+                chunk = chunk->next;
+            }
+
+            /* Take a new chunk and put it right after the current one */
+            if (size > SIZE_MAX - alignment - CHUNK_HEADER_SIZE) { return nullptr; }
+            size_t chunk_size = size + alignment;
+            if (chunk_size < m_chunkSize) { chunk_size = m_chunkSize; }
+            chunk = static_cast<uChunk*>(m_heap.allocate(CHUNK_HEADER_SIZE + chunk_size));
+            if (chunk == nullptr) { return nullptr; }
+            /* The block may be bigger than asked for */
+            chunk->size = m_heap.usable_size(chunk) - CHUNK_HEADER_SIZE;
+            if (m_current != nullptr)
+            {
+                chunk->next = m_current->next;
+                m_current->next = chunk;
+            } else
+            {
+                chunk->next = m_chunks;
+                m_chunks = chunk;
+            }
+            m_current = chunk;
+            uint8_t* ptr = m_align(chunk->begin(), alignment);
+            m_ptr = ptr + size;
+            return ptr;
+        }
+
+        uArena(const uArena&) = delete;
+        uArena& operator=(const uArena&) = delete;
+    };
+
+}  // namespace ufw
+
+/**
+ * @brief stl-compatible allocator over uArena. Deallocation is a no-op, memory is
+ * freed with the arena reset/rollback.
+ * @tparam T
+ * @tparam Lockable - lock type of the arena
+ */
+template <class T, class Lockable = ufw::uNullLock>
+class uArenaAllocator
+{
+   public:
+    typedef T value_type;
+
+    explicit uArenaAllocator(ufw::uArena<Lockable>& arena) noexcept : m_arena(&arena) {}
+
+    template <class U>
+    constexpr uArenaAllocator(const uArenaAllocator<U, Lockable>& other) noexcept : m_arena(other.arena())
+    {
+    }
+
+    T* allocate(size_t n) noexcept
+    {
+        if (n == 0) return nullptr;
+        return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) noexcept {}
+
+    ufw::uArena<Lockable>* arena() const noexcept { return m_arena; }
+
+   private:
+    ufw::uArena<Lockable>* m_arena;
+};
+
+template <class T, class U, class Lockable>
+bool operator==(const uArenaAllocator<T, Lockable>& a, const uArenaAllocator<U, Lockable>& b)
+{
+    return a.arena() == b.arena();
+}
+template <class T, class U, class Lockable>
+bool operator!=(const uArenaAllocator<T, Lockable>& a, const uArenaAllocator<U, Lockable>& b)
+{
+    return a.arena() != b.arena();
+}
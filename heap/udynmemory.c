@@ -40,26 +40,43 @@ void free(void *ptr)
 
 void *calloc(size_t num, size_t size)
 {
-    void *temp = ufw_heap_alloc(num * size);
-    memset(temp, 0x00, num * size);
-    return temp;
+    return ufw_heap_alloc_zeroed(num, size);
 }
 
 void *realloc(void *ptr, size_t new_size)
 {
-    if (new_size == 0) { return NULL; }
-    if (new_size > ufw_heap_getfreebytes())
+    return ufw_heap_realloc(ptr, new_size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    if ((alignment == 0) || ((alignment & (alignment - 1)) != 0))
     {
-        errno = ENOMEM;
+        errno = EINVAL;
         return NULL;
     }
-    void *temp = ufw_heap_alloc(new_size);
-    if (!temp) { return NULL; }
-    memcpy(temp, ptr, new_size);
-    ufw_heap_free(ptr);
-    return temp;
+    return ufw_heap_alloc_aligned(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    if ((alignment == 0) || ((alignment % sizeof(void *)) != 0) || ((alignment & (alignment - 1)) != 0))
+    {
+        return EINVAL;
+    }
+    void *temp = ufw_heap_alloc_aligned(alignment, size);
+    if (!temp && size) { return ENOMEM; }
+    *memptr = temp;
+    return 0;
 }
 
+size_t malloc_usable_size(void *ptr) { return ufw_heap_usable_size(ptr); }
+
     #ifdef UHEAP_WRAPS_NEWLIB_MALLOC
 
 /**
@@ -34,70 +34,56 @@
 
 #include "../uheap_opt.h"
 
-#ifndef UHEAP_HEAP_SIZE
-    #define UHEAP_HEAP_SIZE (120 * 1024)
-#endif
-
 #define UHEAP_FORCEINLINE inline __attribute__((always_inline))
 #define UHEAP_INLINE_VISIBILITY __attribute__ ((__visibility__("hidden"), __always_inline__))
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <type_traits>
+
+#include "uheap_config.h"
+#include "uheap_dump.h"
 
 namespace ufw
 {
+    /**
+     * @fn size_t log2ceil(size_t)
+     * @brief compile-time ceil(log2(value))
+     */
+    constexpr size_t log2ceil(size_t value)
+    {
+        size_t result = 0;
+        while ((((size_t)1) << result) < value) ++result;
+        return result;
+    }
 
     /**
-     * @class uHeap
+     * @enum uPageMode - memory behind a heap
+     */
+    enum class uPageMode : uint8_t
+    {
+        /* Static array or caller-supplied region */
+        region,
+        /* Virtual memory (UHEAP_VIRTUAL_MEMORY) on normal pages */
+        normal,
+        /* Transparent huge pages, madvise(MADV_HUGEPAGE) */
+        transparentHuge,
+        /* Explicit huge pages, MAP_HUGETLB */
+        explicitHuge
+    };
+
+    /**
+     * @class basic_uheap
      * @brief "FreeRTOS heap4"-like dynamic memory management rewritten on C++ without
-     * dependencies to OS.
+     * dependencies to OS. instance() is the global heap of the config, any number of
+     * other heaps may be created over caller-supplied memory regions.
+     * @tparam Config - compile-time configuration, see uheap_config.h
      *
      */
-    class uHeap
+    template <typename Config>
+    class basic_uheap
     {
-#ifndef UHEAP_LOCK_TYPE
-    #ifdef UHEAP_WARNINGS_ENABLE
-    #warning You must provide your own lock
-    #endif
-        /**
-         * @class uDummyLock - spinlock-alike lock
-         */
-        class uDummyLock
-        {
-           private:
-            bool m_locked = false;
-
-           public:
-            void lock()
-            {
-                while (m_locked)
-                    ;
-                m_locked = true;
-            }
-            void unlock() { m_locked = false; }
-        };
-    #define UHEAP_LOCK_TYPE uDummyLock
-#endif
-        /**
-         * @class uGuard<> - just a lock guard as in your stl
-         * @tparam Lockable - the type of the lock. The type must meet the BasicLockable
-         * requirements
-         */
-        template <typename Lockable = UHEAP_LOCK_TYPE>
-        class uGuard
-        {
-           private:
-            Lockable& m_lock_;
-            uGuard(uGuard const&) = delete;
-            uGuard& operator=(uGuard const&) = delete;
-
-           public:
-            UHEAP_INLINE_VISIBILITY
-            explicit uGuard(Lockable& lock) : m_lock_(lock) { m_lock_.lock(); }
-            UHEAP_INLINE_VISIBILITY
-            ~uGuard() { m_lock_.unlock(); }
-        };
-
         /**
          * @class BlockLink_t - forward linked list node of free memory blocks
          */
@@ -108,12 +94,44 @@ namespace ufw
 
             UHEAP_FORCEINLINE
             uint8_t* block() { return (uint8_t*)this + HeapStructSize; }
+            /* Size of the block without the flag bits */
+            UHEAP_FORCEINLINE
+            size_t size() const { return blockSize & ~blockFlagsMask; }
+            /* Physically next block in the heap */
+            UHEAP_FORCEINLINE
+            uBlockLink* next() { return reinterpret_cast<uBlockLink*>((uint8_t*)this + size()); }
+            /* Physically previous block in the heap. Valid only if blockPrevFreeBit is
+             set, then the previous block keeps its size in the last word (boundary tag) */
+            UHEAP_FORCEINLINE
+            uBlockLink* prev() { return reinterpret_cast<uBlockLink*>((uint8_t*)this - ((size_t*)this)[-1]); }
+            /* Header of an allocated block may be read by its owner without the heap lock,
+             while a neighbour flips blockPrevFreeBit under the lock. Such reads and the
+             flag updates of neighbours are relaxed atomic accesses. */
+            UHEAP_FORCEINLINE
+            size_t header() const { return __atomic_load_n(&blockSize, __ATOMIC_RELAXED); }
+            UHEAP_FORCEINLINE
+            size_t headerSize() const { return header() & ~blockFlagsMask; }
+            UHEAP_FORCEINLINE
+            void setPrevFree(bool prev_free)
+            {
+                const size_t value = prev_free ? (blockSize | blockPrevFreeBit) : (blockSize & ~blockPrevFreeBit);
+                __atomic_store_n(&blockSize, value, __ATOMIC_RELAXED);
+            }
+            /* Writes the boundary tag at the end of a free block */
+            UHEAP_FORCEINLINE
+            void setFooter() { ((size_t*)next())[-1] = size(); }
+            /* Free blocks keep the back link of their size class list in the first
+             payload word, so the header layout stays the same */
+            UHEAP_FORCEINLINE
+            uBlockLink*& prevFreeBlock() { return *reinterpret_cast<uBlockLink**>(block()); }
         };
 
         static constexpr size_t BITS_PER_BYTE = 8;
         /* Alignment settings */
-        static constexpr size_t BYTE_ALIGNMENT = 16;
+        static constexpr size_t BYTE_ALIGNMENT = Config::alignment;
         static constexpr size_t BYTE_ALIGNMENT_MASK = BYTE_ALIGNMENT - 1;
+        static_assert(((BYTE_ALIGNMENT & BYTE_ALIGNMENT_MASK) == 0) && (BYTE_ALIGNMENT >= sizeof(size_t)),
+                      "Alignment must be a power of two not less than sizeof(size_t)");
 
         /* The size of the structure placed at the beginning of each allocated memory
          block must by correctly byte aligned. */
@@ -125,29 +143,225 @@ namespace ufw
          application.  When the bit is free the block is still part of the free heap
          space. */
         static constexpr size_t blockAllocatedBit = ((size_t)1) << ((sizeof(size_t) * 8) - 1);
+        /* Set in blockSize when the physically previous block is free, so the block can
+         be merged with it through the boundary tag without any list traversal. */
+        static constexpr size_t blockPrevFreeBit = blockAllocatedBit >> 1;
+        /* Set in blockSize of a free block whose whole pages were given back to the OS
+         by trim(), so they read as zeros (see m_knownZero) */
+        static constexpr size_t blockZeroedBit = blockPrevFreeBit >> 1;
+        static constexpr size_t blockFlagsMask = blockAllocatedBit | blockPrevFreeBit | blockZeroedBit;
 
         static constexpr size_t MINIMUM_BLOCK_SIZE = (HeapStructSize << 1);
 
+        /* Two-level segregated fit (TLSF) index settings. First level splits block
+         sizes by powers of two, second level splits every power of two range into
+         SL_INDEX_COUNT linear classes. Blocks smaller than SMALL_BLOCK_SIZE share
+         the first class row with BYTE_ALIGNMENT granularity. */
+        static constexpr size_t SL_INDEX_COUNT_LOG2 = 4;
+        static constexpr size_t SL_INDEX_COUNT = ((size_t)1) << SL_INDEX_COUNT_LOG2;
+        static constexpr size_t FL_INDEX_SHIFT = SL_INDEX_COUNT_LOG2 + log2ceil(BYTE_ALIGNMENT);
+        static constexpr size_t SMALL_BLOCK_SIZE = ((size_t)1) << FL_INDEX_SHIFT;
+        static constexpr size_t FL_INDEX_MAX =
+            (log2ceil(Config::maxHeapSize) > FL_INDEX_SHIFT) ? log2ceil(Config::maxHeapSize) : FL_INDEX_SHIFT + 1;
+        static constexpr size_t FL_INDEX_COUNT = FL_INDEX_MAX - FL_INDEX_SHIFT + 1;
+
+        static_assert(FL_INDEX_COUNT <= sizeof(size_t) * BITS_PER_BYTE, "Heap is too large for TLSF index");
+
+#ifdef UHEAP_THREAD_CACHE
+        /**
+         * @class uThreadCache - per-thread bins of recently freed small blocks.
+         * Cached blocks stay allocated from the heap point of view, they are linked
+         * through nextFreeBlock and the list is terminated with the address of the heap
+         * object, so a cached block never looks like an allocated one to m_free.
+         */
+        class uThreadCache
+        {
+           public:
+            static constexpr size_t MAX_BLOCK_SIZE =
+                ((UHEAP_THREAD_CACHE_MAX_SIZE + HeapStructSize + BYTE_ALIGNMENT_MASK) & ~BYTE_ALIGNMENT_MASK);
+            static constexpr size_t BIN_COUNT = (MAX_BLOCK_SIZE - MINIMUM_BLOCK_SIZE) / BYTE_ALIGNMENT + 1;
+            static constexpr size_t BATCH = UHEAP_THREAD_CACHE_BATCH;
+
+            constexpr uThreadCache() = default;
+            ~uThreadCache();
+
+            /**
+             * @brief local - cache of the calling thread
+             */
+            static uThreadCache& local();
+            /**
+             * @brief accepts - is the cache usable for the given heap? A cache serves
+             * only the global heap and is disabled after the thread-exit flush.
+             */
+            UHEAP_FORCEINLINE bool accepts(const basic_uheap& heap) const
+            {
+                return !m_disabled && heap.m_threadCached;
+            }
+
+            void* allocate(basic_uheap& heap, size_t new_size);
+            /**
+             * @param size - caller-known size of the block or 0 if unknown
+             * @return false if the block can't be cached and must be freed to the heap
+             */
+            bool deallocate(basic_uheap& heap, void* pv, size_t size = 0);
+            /**
+             * @brief flush - return all cached blocks to the heap
+             */
+            void flush();
+
+           private:
+            basic_uheap* m_heap = nullptr;
+            bool m_disabled = false;
+            uBlockLink* m_bins[BIN_COUNT] = {};
+            size_t m_counts[BIN_COUNT] = {};
+
+            UHEAP_FORCEINLINE void m_push(size_t bin, uBlockLink* block);
+            UHEAP_FORCEINLINE uBlockLink* m_pop(size_t bin);
+            void m_refill(size_t bin, size_t new_size);
+            void m_release(size_t bin, size_t count);
+        };
+        friend class uThreadCache;
+#endif
+
+       public:
+        using uPageMode = ::ufw::uPageMode;
+
+        /**
+         * @struct uStats - snapshot of the heap state returned by stats()
+         */
+        struct uStats
+        {
+            static constexpr size_t HISTOGRAM_BINS = sizeof(size_t) * BITS_PER_BYTE;
+
+            size_t capacity;
+            size_t freeBytes;
+            size_t lowWatermark;
+            /* Biggest request that can be served now is a bit less than this */
+            size_t largestFreeBlock;
+            size_t freeBlocks;
+            /* Counters below are zero unless Config::stats is set (UHEAP_STATS). Requests served by
+             thread caches are counted when the cache is refilled or released. */
+            size_t allocations;
+            size_t deallocations;
+            /* Allocations which called uHeapFullHook */
+            size_t failedAllocations;
+            /* Requests of [2^i, 2^(i+1)) bytes are counted in sizeHistogram[i] */
+            size_t sizeHistogram[HISTOGRAM_BINS];
+            /* Size classes looked at per free block search */
+            size_t searches;
+            size_t searchSteps;
+            size_t maxSearchSteps;
+            /* Neighbour blocks merged per freed block */
+            size_t inserts;
+            size_t insertMerges;
+            size_t maxInsertMerges;
+            /* Blocks served directly by mmap (UHEAP_MMAP_THRESHOLD) and their size */
+            size_t mappedBlocks;
+            size_t mappedBytes;
+            /* Pages of the heap, committed memory is pre-faulted (UHEAP_VM_PREFAULT) and
+             locked in RAM (UHEAP_VM_MLOCK) */
+            uPageMode pageMode;
+            bool prefaulted;
+            bool locked;
+
+            /**
+             * @brief fragmentation - part of the free memory not usable for the biggest
+             * allocation, 0 if all of it is one block
+             */
+            double fragmentation() const
+            {
+                return (freeBytes != 0) ? 1.0 - static_cast<double>(largestFreeBlock) / freeBytes : 0.0;
+            }
+            double averageSearchSteps() const
+            {
+                return (searches != 0) ? static_cast<double>(searchSteps) / searches : 0.0;
+            }
+            double averageInsertMerges() const
+            {
+                return (inserts != 0) ? static_cast<double>(insertMerges) / inserts : 0.0;
+            }
+        };
+
        private:
-        /* Raw heap array */
-        uint8_t heapBase[UHEAP_HEAP_SIZE] = {};
+        /* Heap memory region */
+        uint8_t* m_heapBase = nullptr;
+        size_t m_heapSize = 0UL;
 
-        /* Links to mark the start and end of the list. */
-        uBlockLink m_start{};
+        /* Links to mark the first block and the end of the heap. */
+        uBlockLink* m_startptr = nullptr;
         uBlockLink* m_endptr = nullptr;
 
+        /* Segregated free lists and bitmaps of non-empty lists */
+        size_t m_flBitmap = 0UL;
+        uint32_t m_slBitmap[FL_INDEX_COUNT] = {};
+        uBlockLink* m_freeLists[FL_INDEX_COUNT][SL_INDEX_COUNT] = {};
+
+        /* Free block placement policy, see uheap_placement.h */
+        using uPlacement = typename Config::placement;
+        /* End of the last allocated block, used by roving policies */
+        const void* m_rover = nullptr;
+
+        /* Nothing was ever allocated at or above this address, so memory from here up
+         * to the end is zero apart from the header, list link and boundary tag of the
+         * last free block. The end of the heap if the region isn't known to be zero. */
+        uint8_t* m_zeroFrom = nullptr;
+
         /* Keeps track of the number of free bytes remaining, but says nothing about
          * fragmentation. */
         size_t m_freeBytesRemaining = 0UL;
         size_t m_memoryLowWatermark = 0UL;
 
         /* Interrnal lock */
-        UHEAP_LOCK_TYPE m_lock{};
+        typename Config::lock_type m_lock{};
+
+        /* Counters of stats(), updated under the lock. Empty if Config::stats is off. */
+        struct uNoCounters
+        {
+        };
+        typename std::conditional<Config::stats, uStats, uNoCounters>::type m_counters{};
+        UHEAP_FORCEINLINE void m_countAllocation(size_t size);
+        UHEAP_FORCEINLINE void m_countDeallocation();
+        UHEAP_FORCEINLINE void m_countSearch(size_t steps);
+        UHEAP_FORCEINLINE void m_countInsert(size_t merges);
+        UHEAP_FORCEINLINE static void m_countSteps(size_t& count, size_t& total, size_t& max, size_t steps);
+
+        /* Blocks freed with Config::deferredFree. They are linked through nextFreeBlock
+         and the list is terminated with the address of the heap, like thread cache bins,
+         so a deferred block never looks allocated. Pushed without the lock, taken all at
+         once under it. */
+        std::atomic<uBlockLink*> m_deferred{nullptr};
+        std::atomic<size_t> m_deferredCount{0};
+
+#ifdef UHEAP_THREAD_CACHE
+        /* Thread caches serve only the global heap, other instances may be destroyed
+         while a cache still holds their blocks */
+        bool m_threadCached = false;
+#endif
+
+#ifdef UHEAP_MMAP_THRESHOLD
+        /* Blocks mapped by this heap, updated under the lock */
+        size_t m_mappedBlocks = 0UL;
+        size_t m_mappedBytes = 0UL;
+#endif
+
+#ifdef UHEAP_VIRTUAL_MEMORY
+        /* Reserved address space and committed part of it, 0 for heaps over caller
+         regions. m_heapSize follows the committed size. */
+        size_t m_vmReserved = 0UL;
+        size_t m_vmCommitted = 0UL;
+        /* Commit and trim granularity */
+        size_t m_vmPageSize = 0UL;
+        uPageMode m_vmPageMode = uPageMode::region;
+        bool m_vmLocked = false;
+        /* Bytes freed since the last trim and the time decay() has seen them first */
+        size_t m_vmDirtyBytes = 0UL;
+        uint64_t m_vmDirtySince = 0UL;
+#endif
 
         /**
-         * @brief uHeap - Constructor. Setup the required heap structures.
+         * @brief basic_uheap - Constructor of the global heap over the static heap array.
          */
-        uHeap();
+        basic_uheap();
 
         /**
          * @brief heapError - called when error causes
@@ -162,36 +376,280 @@ namespace ufw
         /**
          * @brief m_insertFreeBlock
          * @param BlockToInsert
-         * Inserts a block of memory that is being freed into the correct position in
-         * the list of free memory blocks.  The block being freed will be merged with
-         * the block in front it and/or the block behind it if the memory blocks are
-         * adjacent to each other.
+         * Inserts a block of memory that is being freed into the free lists index.
+         * The block being freed will be merged with the block in front it and/or
+         * the block behind it if the memory blocks are adjacent to each other.
          */
         UHEAP_FORCEINLINE void m_insertFreeBlock(uBlockLink* BlockToInsert);
+        /**
+         * @brief m_linkFreeBlock/m_unlinkFreeBlock - add/remove free block to/from
+         * its size class list without merging. Linking also writes the boundary tag
+         * of the block and marks the next block.
+         * @param block
+         */
+        UHEAP_FORCEINLINE void m_linkFreeBlock(uBlockLink* block);
+        UHEAP_FORCEINLINE void m_unlinkFreeBlock(uBlockLink* block);
+        /**
+         * @brief m_mappingInsert - size class of a block of given size
+         */
+        UHEAP_FORCEINLINE void m_mappingInsert(size_t size, size_t& fl, size_t& sl);
+        /**
+         * @brief m_findFreeBlock - finds a free block of at least the given size. The
+         * placement policy may look into the class of the size first, otherwise the size
+         * is rounded up to the next class, where every block fits, so the search of a
+         * list is O(1).
+         * @return block chosen by the placement policy (still linked) or nullptr
+         */
+        UHEAP_FORCEINLINE uBlockLink* m_findFreeBlock(size_t size);
+        /* Address range [begin, end) */
+        struct uRange
+        {
+            size_t begin;
+            size_t end;
+        };
+        /**
+         * @brief m_knownZero - part of a free block that is known to read as zeros, the
+         * never allocated end of the heap or pages released by trim()
+         * @return empty range if there is no such part
+         */
+        UHEAP_FORCEINLINE uRange m_knownZero(uBlockLink* block);
         // Internal malloc and free functions wrapped by public ones for debug
         // purposes
-        UHEAP_FORCEINLINE void* m_malloc(size_t new_size);
+        /**
+         * @param zero - if not nullptr gets the known zero part of the block the request
+         * was served from
+         */
+        UHEAP_FORCEINLINE void* m_malloc(size_t new_size, uRange* zero = nullptr);
+        UHEAP_FORCEINLINE void* m_mallocAligned(size_t new_size, size_t alignment);
+        /**
+         * @brief m_useBlock - splits off the unused tail of a block taken from the free
+         * lists and marks it allocated
+         * @param p_block - unlinked free block
+         * @param new_size - aligned block size including the header
+         * @return payload of the block
+         */
+        UHEAP_FORCEINLINE void* m_useBlock(uBlockLink* p_block, size_t new_size);
+        /**
+         * @brief m_carveBlock - cuts up to count blocks of the same size from one free
+         * block in a single pass, the unused tail goes back to the free lists
+         * @param p_block - unlinked free block
+         * @param new_size - aligned block size including the header
+         * @return number of blocks written to out
+         */
+        size_t m_carveBlock(uBlockLink* p_block, size_t new_size, size_t count, void** out);
         UHEAP_FORCEINLINE void m_free(void* pv);
+        /**
+         * @brief m_deferFree - pushes an allocated block to the deferred list without
+         * locking, frees the list if it is long and the lock is free
+         */
+        void m_deferFree(void* pv);
+        /**
+         * @brief m_drainDeferred - frees all deferred blocks, called under the lock
+         */
+        UHEAP_FORCEINLINE void m_drainDeferred();
+        /**
+         * @brief m_resize - grows the block into the physically next free block or
+         * splits off its tail, never moves it
+         * @param block - allocated block
+         * @param new_size - wanted payload size
+         * @return true if the block holds new_size bytes now
+         */
+        UHEAP_FORCEINLINE bool m_resize(uBlockLink* block, size_t new_size);
+        /**
+         * @brief m_allocatedBlock - header of an allocated block owned by the heap
+         * @return nullptr if pv isn't an allocated heap block
+         */
+        UHEAP_FORCEINLINE uBlockLink* m_allocatedBlock(void* pv);
+        /**
+         * @brief m_grow - commits more reserved memory at the end of the heap, the new
+         * pages are merged with the last block if it is free
+         * @param size - aligned size of the block that must fit after the growth
+         * @return false if the heap isn't growable or the reserve is exhausted
+         */
+        bool m_grow(size_t size);
+        /**
+         * @brief m_trim - gives the pages inside big free blocks back to the OS
+         * @return number of released bytes
+         */
+        size_t m_trim();
+#ifdef UHEAP_MMAP_THRESHOLD
+        /**
+         * @brief m_mapBlock - maps a block for a big request. The payload starts one
+         * header into the page, the header keeps the mapping size and a tag made of its
+         * address instead of the free list link.
+         * @return payload or nullptr if mmap failed
+         */
+        void* m_mapBlock(size_t new_size);
+        /**
+         * @brief m_mappedBlock - header of a block served by mmap
+         * @return nullptr if pv isn't a mapped block
+         */
+        uBlockLink* m_mappedBlock(void* pv);
+        /**
+         * @brief m_unmapBlock - gives a mapped block back to the OS
+         * @return false if pv isn't a mapped block
+         */
+        bool m_unmapBlock(void* pv);
+        /**
+         * @brief m_remapBlock - resizes a mapped block with mremap
+         * @param may_move - the block may get a new address
+         * @return payload of the resized block or nullptr
+         */
+        void* m_remapBlock(uBlockLink* block, size_t new_size, bool may_move);
+        /**
+         * @brief m_countMapped - updates mapped blocks counters
+         */
+        void m_countMapped(ptrdiff_t blocks, ptrdiff_t bytes);
+#endif
+        /**
+         * @brief m_availableBytes - free bytes including the uncommitted reserve
+         */
+        UHEAP_FORCEINLINE size_t m_availableBytes() const
+        {
+#ifdef UHEAP_VIRTUAL_MEMORY
+            return m_freeBytesRemaining + (m_vmReserved - m_vmCommitted);
+#else
+            return m_freeBytesRemaining;
+#endif
+        }
+        /**
+         * @brief m_walk - visit every block without locking
+         */
+        template <typename Visitor>
+        void m_walk(Visitor& visitor)
+        {
+            if (m_startptr == nullptr) { return; }
+            for (uBlockLink* block = m_startptr; block != m_endptr; block = block->next())
+            {
+                visitor(uBlockInfo{block->block(), block->size(), (block->blockSize & blockAllocatedBit) != 0});
+            }
+        }
+#ifdef UHEAP_DEBUG_CHECKS
+        /**
+         * @brief m_checkBlockSize - does the caller-known size match the block header?
+         */
+        bool m_checkBlockSize(void* pv, size_t size);
+#endif
 
        public:
+        /**
+         * @brief basic_uheap - Constructor. Setup the required heap structures in the given
+         * memory region. Regions bigger than Config::maxHeapSize are truncated.
+         * @param region - memory to manage, must outlive the heap
+         * @param size - size of the region in bytes
+         * @param zeroed - the region is filled with zeros, allocate_zeroed() doesn't
+         * clear memory that was never allocated then
+         */
+        basic_uheap(void* region, size_t size, bool zeroed = false);
+        ~basic_uheap() = default;
+
         /**
          * @fn uHeapManager instance&()
          * @brief Return reference to a memory object. Instantiates it if invoked the
          * first time.
          */
-        static uHeap& instance();
+        static basic_uheap& instance();
         /**
          * @fn void allocate*(size_t)
          * @brief Allocate number of bytes
          * @param new_size
          */
         void* allocate(size_t new_size);
+        /**
+         * @fn void allocate_zeroed*(size_t, size_t)
+         * @brief Allocate count * size bytes filled with zeros (calloc). Memory that was
+         * never allocated and pages released by trim() aren't cleared again.
+         * @param count
+         * @param size
+         * @return nullptr if there is no memory or count * size overflows
+         */
+        void* allocate_zeroed(size_t count, size_t size);
+        /**
+         * @fn void allocate_aligned*(size_t, size_t)
+         * @brief Allocate number of bytes aligned to the given boundary
+         * @param new_size
+         * @param alignment - power of two
+         */
+        void* allocate_aligned(size_t new_size, size_t alignment);
         /**
          * @fn void deallocate(void*)
-         * @brief Deallocate previousely allocated block
+         * @brief Deallocate previousely allocated block. With Config::deferredFree the
+         * block is queued without locking and freed by the next allocation.
          * @param pv
          */
         void deallocate(void* pv);
+        /**
+         * @fn void deallocate(void*, size_t)
+         * @brief Deallocate previousely allocated block of known size. The size must
+         * be the one requested at allocation (or resize), it is checked against the
+         * block header if UHEAP_DEBUG_CHECKS is defined. The size only selects the path:
+         * small blocks go to their thread cache bin without decoding the header, blocks
+         * below UHEAP_MMAP_THRESHOLD skip the mapping lookup. Blocks returned to the
+         * free lists are merged by their header like in deallocate(void*).
+         * @param pv
+         * @param size
+         */
+        void deallocate(void* pv, size_t size);
+        /**
+         * @fn void reallocate*(void*, size_t)
+         * @brief Resize previousely allocated block. The block is resized in place if
+         * possible, otherwise it is moved and only the old payload is copied. Blocks
+         * crossing UHEAP_MMAP_THRESHOLD move between the heap and their own mapping.
+         * @param pv - block to resize (nullptr to allocate a new one)
+         * @param new_size - new size in bytes (0 to deallocate)
+         * @return resized block or nullptr if there is no memory (pv is still valid)
+         */
+        void* reallocate(void* pv, size_t new_size);
+        /**
+         * @fn bool try_expand(void*, size_t)
+         * @brief Resize previousely allocated block in place, never moves it
+         * @param pv
+         * @param new_size
+         * @return true if the block holds new_size bytes now
+         */
+        bool try_expand(void* pv, size_t new_size);
+        /**
+         * @fn size_t usable_size(void*)
+         * @brief Number of bytes of an allocated block the owner may use, not less than
+         * the requested size (malloc_usable_size). Requests are rounded up to the block
+         * alignment and tails too small to split stay in the block, the caller may use
+         * them without reallocation.
+         * @param pv
+         * @return 0 for nullptr or a pointer not allocated by this heap
+         */
+        size_t usable_size(void* pv);
+        /**
+         * @fn void fork_prepare()
+         * @brief Lock the heap before fork(), so the child doesn't get it in the middle of
+         * an operation of another thread. Register with
+         * pthread_atfork(prepare, release, release), see heap/uheap_preload.cpp.
+         */
+        void fork_prepare();
+        /**
+         * @fn void fork_release()
+         * @brief Unlock the heap after fork() in the parent and in the child
+         */
+        void fork_release();
+        /**
+         * @fn size_t allocate_batch(size_t, size_t, void**)
+         * @brief Allocate count blocks of the same size under one lock. Blocks are cut
+         * from as few free blocks as possible, so they are mostly adjacent.
+         * @param new_size - size of every block
+         * @param count
+         * @param out - array of at least count pointers
+         * @return number of allocated blocks, the rest of out is left untouched
+         */
+        size_t allocate_batch(size_t new_size, size_t count, void** out);
+        /**
+         * @fn void deallocate_batch(void**, size_t)
+         * @brief Deallocate count blocks under one lock. Pointers are sorted by address
+         * in place and runs of adjacent blocks are returned as one free block. Entries
+         * of mapped blocks (UHEAP_MMAP_THRESHOLD) are set to nullptr.
+         * @param ptrs - blocks to free, nullptr entries are skipped, pointers that aren't
+         * allocated blocks of this heap (or are listed twice) go to the error hook
+         * @param count
+         */
+        void deallocate_batch(void** ptrs, size_t count);
         /**
          * @fn size_t getFreeBytesRemaining()
          * @brief Returns number of free bytes remaining
@@ -202,20 +660,93 @@ namespace ufw
          * @brief Returns the minimum ever number of free bytes.
          */
         const size_t& getMemoryLowWatermark() const;
+        /**
+         * @fn uStats stats()
+         * @brief Snapshot of the heap state. Walks the free lists under the heap lock,
+         * so it takes time proportional to the number of free blocks.
+         */
+        uStats stats();
+        /**
+         * @fn size_t trim()
+         * @brief Give the pages inside free blocks of at least UHEAP_VM_TRIM_THRESHOLD
+         * bytes back to the OS (madvise(MADV_DONTNEED)). Block headers and boundary tags
+         * stay in place, released pages read as zeros when they are used again. Does
+         * nothing unless the heap is backed by virtual memory (UHEAP_VIRTUAL_MEMORY).
+         * @return number of released bytes
+         */
+        size_t trim();
+        /**
+         * @fn size_t decay()
+         * @brief Decay policy for a background thread or an idle hook, call it
+         * periodically. Trims the heap once at least UHEAP_VM_TRIM_THRESHOLD bytes were
+         * freed and UHEAP_VM_DECAY_MS have passed since a call has seen them, so memory
+         * reused soon after free isn't released.
+         * @return number of released bytes
+         */
+        size_t decay();
+
+        /**
+         * @struct uBlockInfo - block visited by walk()
+         */
+        struct uBlockInfo
+        {
+            /* Payload of the block */
+            void* address;
+            /* Size of the block including its header */
+            size_t size;
+            /* Blocks held by thread caches are allocated */
+            bool allocated;
+        };
+        /**
+         * @fn void walk(Visitor&&)
+         * @brief Call visitor(const uBlockInfo&) for every block in address order. The
+         * heap is locked during the walk, the visitor must not use this heap.
+         */
+        template <typename Visitor>
+        void walk(Visitor&& visitor)
+        {
+            // LOCK (unlocked at scope exit)
+            uGuard walk_guard(m_lock);
+            m_walk(visitor);
+        }
+        /**
+         * @brief uDumpWriter - sink of dump(), gets the dump in small pieces
+         */
+        using uDumpWriter = void (*)(const void* data, size_t size, void* context);
+        /**
+         * @fn void dump(uDumpWriter, void*)
+         * @brief Write the binary heap map (see uheap_dump.h). Uses neither the heap nor
+         * the heap lock, so it can be called from uHeapFullHook where the lock is held by
+         * the failing allocation. Elsewhere no other thread may use the heap meanwhile.
+         * @param writer
+         * @param context - passed to the writer
+         */
+        void dump(uDumpWriter writer, void* context);
 
         /**
          * @brief max_capacity
          * @return Capacity of heap
          */
-        static constexpr size_t max_capacity();
+        static constexpr size_t max_capacity()
+        {
+#ifdef UHEAP_VIRTUAL_MEMORY
+            return Config::maxHeapSize;
+#else
+            return Config::heapSize;
+#endif
+        }
+        /**
+         * @brief capacity
+         * @return Size of the memory region managed by this heap
+         */
+        size_t capacity() const { return m_heapSize; }
 
        private:
         /* Rule of five */
-        ~uHeap() = default;
-        uHeap(const uHeap& other) = delete;
-        uHeap(uHeap&& other) = delete;
-        uHeap& operator=(const uHeap& other) = delete;
-        uHeap& operator=(uHeap&& other) = delete;
+        basic_uheap(const basic_uheap& other) = delete;
+        basic_uheap(basic_uheap&& other) = delete;
+        basic_uheap& operator=(const basic_uheap& other) = delete;
+        basic_uheap& operator=(basic_uheap&& other) = delete;
         /* End rule of five */
 
         /* Inlines */
@@ -223,14 +754,14 @@ namespace ufw
          * @brief begin - pointer to heap (raw)
          * @return
          */
-        UHEAP_FORCEINLINE size_t begin() { return reinterpret_cast<size_t>(heapBase); }
+        UHEAP_FORCEINLINE size_t begin() { return reinterpret_cast<size_t>(m_heapBase); }
         /**
          * @brief end - pointer to heap end (raw)
          * @return
          */
         UHEAP_FORCEINLINE size_t end()
         {
-            return reinterpret_cast<size_t>(&heapBase[UHEAP_HEAP_SIZE]);
+            return reinterpret_cast<size_t>(m_heapBase + m_heapSize);
         }
 
         /**
@@ -241,7 +772,7 @@ namespace ufw
          */
         UHEAP_FORCEINLINE bool isOwned(void* ptr)
         {
-            return ((ptr >= heapBase) && (ptr < heapBase + UHEAP_HEAP_SIZE));
+            return ((ptr >= m_heapBase) && (ptr < m_heapBase + m_heapSize));
         }
 
         UHEAP_FORCEINLINE size_t allignBlock(size_t block)
@@ -251,4 +782,10 @@ namespace ufw
         /* End inlines */
     };
 
+    /**
+     * @brief uHeap - heap configured with uheap_opt.h options, instantiated in uheap.cpp
+     */
+    using uHeap = basic_uheap<uHeapConfig>;
+    extern template class basic_uheap<uHeapConfig>;
+
 } /* namespace heap */
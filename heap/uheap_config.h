@@ -0,0 +1,88 @@
+/**
+ * @file uheap_config.h
+ * @author Dmitry Donskikh (deedonskihdev@gmail.com)
+ * @brief Compile-time configuration of basic_uheap<Config>
+ * @version 0.1
+ * @date 2021-11-06
+ *
+ * Copyright (c) 2018-2021 Dmitriy Donskikh
+ * All rights reserved.
+ *
+ * A config is a type with the members of uHeapConfig. Derive from it and override what
+ * differs, e.g. a heap used by one thread only:
+ *
+ *     struct LocalConfig : ufw::uHeapConfig
+ *     {
+ *         using lock_type = ufw::uNullLock;
+ *         static constexpr size_t maxHeapSize = 64 * 1024;
+ *     };
+ *     ufw::basic_uheap<LocalConfig> local_heap(buffer, sizeof(buffer));
+ *
+ * Heaps of other configs than uHeapConfig need heap/uheap_impl.h in the translation
+ * unit that uses them. UHEAP_THREAD_CACHE, UHEAP_VIRTUAL_MEMORY, UHEAP_MMAP_THRESHOLD,
+ * UHEAP_TRACE and UHEAP_DEBUG_CHECKS stay global options of the build.
+ */
+
+#pragma once
+
+#include "../uheap_opt.h"
+
+#include <cstddef>
+
+#include "uheap_locks.h"
+#include "uheap_placement.h"
+
+#ifndef UHEAP_HEAP_SIZE
+    #define UHEAP_HEAP_SIZE (120 * 1024)
+#endif
+
+#ifndef UHEAP_LOCK_TYPE
+    #define UHEAP_LOCK_TYPE ::ufw::uSpinLock
+#endif
+
+#ifndef UHEAP_PLACEMENT_POLICY
+    #define UHEAP_PLACEMENT_POLICY ::ufw::uGoodFit
+#endif
+
+extern "C" void uHeapErrorHook();
+extern "C" void uHeapFullHook();
+
+namespace ufw
+{
+    /**
+     * @struct uHeapConfig - configuration of uHeap, taken from uheap_opt.h options
+     */
+    struct uHeapConfig
+    {
+        /* Size of the static array (or the initial commit) of instance() */
+        static constexpr size_t heapSize = UHEAP_HEAP_SIZE;
+        /* Largest region a heap can manage, defines the size of the free lists index */
+        static constexpr size_t maxHeapSize = UHEAP_MAX_HEAP_SIZE;
+        /* Alignment of blocks, power of two not less than sizeof(size_t) */
+        static constexpr size_t alignment = 16;
+        /* "BasicLockable" lock of the heap */
+        using lock_type = UHEAP_LOCK_TYPE;
+        /* Free block placement policy, see uheap_placement.h */
+        using placement = UHEAP_PLACEMENT_POLICY;
+#ifdef UHEAP_STATS
+        static constexpr bool stats = true;
+#else
+        /* Count allocations, frees and searches for stats() */
+        static constexpr bool stats = false;
+#endif
+#ifdef UHEAP_DEFERRED_FREE
+        static constexpr bool deferredFree = true;
+#else
+        /* Push freed blocks to a lock-free list, allocations free them in bulk */
+        static constexpr bool deferredFree = false;
+#endif
+        /* Deferred blocks count at which the freeing thread tries to free them itself */
+        static constexpr size_t deferredFreeThreshold = UHEAP_DEFERRED_FREE_THRESHOLD;
+
+        /* Called with the heap lock held when a request can't be served */
+        static void fullHook() { uHeapFullHook(); }
+        /* Called on a bad pointer or a region that can't hold a heap */
+        static void errorHook() { uHeapErrorHook(); }
+    };
+
+}  // namespace ufw
@@ -0,0 +1,63 @@
+/**
+ * @file uheap_dump.h
+ * @author Dmitry Donskikh (deedonskihdev@gmail.com)
+ * @brief Binary heap map format written by uHeap::dump()
+ * @version 0.1
+ * @date 2021-10-12
+ *
+ * Copyright (c) 2018-2021 Dmitriy Donskikh
+ * All rights reserved.
+ *
+ * The dump is a uHeapDumpHeader followed by uint32_t records of the blocks in address
+ * order, starting at heapBase + firstBlock, and a zero record at the end. A record is
+ * continued << 31 | (units << 1) | allocated, where units is the block size (including
+ * the block header) in granularity bytes. One record holds up to UHEAP_DUMP_MAX_UNITS
+ * units (16 GiB with 16-byte granularity), bigger blocks are written as several
+ * records, all but the last with the continued bit, and their units add up. Version 1
+ * dumps have no continued bit and 31-bit units. All fields are in the byte order of
+ * the target.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace ufw
+{
+    constexpr uint32_t UHEAP_DUMP_MAGIC = 0x504D4855UL; /* "UHMP" */
+    constexpr uint16_t UHEAP_DUMP_VERSION = 2;
+    /* Set in all but the last record of a block */
+    constexpr uint32_t UHEAP_DUMP_CONTINUED = 0x80000000UL;
+    /* Units held by one record */
+    constexpr uint64_t UHEAP_DUMP_MAX_UNITS = (UHEAP_DUMP_CONTINUED >> 1) - 1;
+
+    /**
+     * @struct uHeapDumpHeader - heap state at the moment of the dump
+     */
+    struct uHeapDumpHeader
+    {
+        uint32_t magic;
+        uint16_t version;
+        /* Unit of block sizes in records */
+        uint16_t granularity;
+        uint64_t heapBase;
+        uint64_t heapSize;
+        /* Offset of the first block from heapBase */
+        uint64_t firstBlock;
+        uint64_t freeBytes;
+        uint64_t lowWatermark;
+    };
+
+    /**
+     * @fn uint32_t uHeapDumpRecord(uint64_t, bool, bool)
+     * @brief One record of a block
+     * @param units - not more than UHEAP_DUMP_MAX_UNITS
+     * @param allocated
+     * @param continued - more records of the same block follow
+     */
+    constexpr uint32_t uHeapDumpRecord(uint64_t units, bool allocated, bool continued = false)
+    {
+        return static_cast<uint32_t>((units << 1) | (allocated ? 1U : 0U)) | (continued ? UHEAP_DUMP_CONTINUED : 0U);
+    }
+
+}  // namespace ufw
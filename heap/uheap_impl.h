@@ -0,0 +1,1721 @@
+/**
+ * @file uheap_impl.h
+ * @author Dmitry Donskikh (deedonskihdev@gmail.com)
+ * @brief basic_uheap<Config> member definitions
+ * @version 0.1
+ * @date 2018-11-29
+ * 
+ * Copyright (c) 2018-2021 Dmitriy Donskikh
+ * All rights reserved.
+ * 
+ * uHeap is instantiated once in uheap.cpp, include this header to use heaps of other
+ * configs.
+ */
+
+#pragma once
+
+#include <heap/uheap.h>
+#include <heap/uheap_trace.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+
+#if defined(UHEAP_VIRTUAL_MEMORY) || defined(UHEAP_MMAP_THRESHOLD)
+    #define UHEAP_USING_MMAP
+    #include <sys/mman.h>
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+#ifdef UHEAP_SECTION
+    #define UHEAP_SECTION_INT __attribute__((section(UHEAP_SECTION)))
+#else
+    #define UHEAP_SECTION_INT
+#endif
+
+//#include "sys/itm.h"
+//
+//    #define _U_DEBUG_ALLOCATE(NEW,REM,MIN) \
+//itmPuts("Allocated: ");itmPutN(NEW);itmPuts("bytes Remaining: ");itmPutN(REM);itmPuts(" Min:
+// ");itmPutN(MIN);itmPuts("\n");\
+//
+//    #define _U_DEBUG_DEALLOCATE(REM,MIN) \
+//itmPuts("MEM FREE! Remaining: ");itmPutN(REM);itmPuts(" Min: ");itmPutN(MIN);itmPuts("\n");\
+
+#define U_DEBUG_DEALLOCATE(REM, MIN)
+#define U_DEBUG_ALLOCATE(NEW, REM, MIN)
+
+/* Counters compile to nothing unless Config::stats is set */
+#define U_STATS_ALLOCATION(SIZE) m_countAllocation(SIZE)
+#define U_STATS_DEALLOCATION() m_countDeallocation()
+#define U_STATS_SEARCH(STEPS) m_countSearch(STEPS)
+#define U_STATS_INSERT(MERGES) m_countInsert(MERGES)
+
+#ifdef UHEAP_VIRTUAL_MEMORY
+    #define U_VM_DIRTY(SIZE) (m_vmDirtyBytes += (SIZE))
+#else
+    #define U_VM_DIRTY(SIZE)
+#endif
+
+#ifdef UHEAP_TRACE
+    #define U_TRACE(OP, PTR, SIZE, PREV) \
+        if ((PTR) != nullptr) { uTrace::record(uTraceOp::OP, (PTR), (SIZE), (PREV)); }
+#else
+    #define U_TRACE(OP, PTR, SIZE, PREV)
+#endif
+
+#define userheapASSERT(x)                       \
+    if ((x) != true)                            \
+    {                                           \
+        UHEAP_DEBUG("Assertation failed at\n"); \
+        UHEAP_DEBUG(__PRETTY_FUNCTION__);       \
+        UHEAP_DEBUG("\n");                      \
+        UHEAP_ABORT(-1);                        \
+    }
+
+namespace ufw
+{
+    namespace detail
+    {
+#ifdef UHEAP_USING_MMAP
+        inline size_t pageSize()
+        {
+            static const size_t s_pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            return s_pageSize;
+        }
+
+        inline size_t alignUp(size_t value, size_t page) { return (value + page - 1) & ~(page - 1); }
+#endif
+
+#ifdef UHEAP_MMAP_THRESHOLD
+        /* Tag of a mapped block header, foreign pointers are unlikely to have it. The heap
+         address is mixed in, so a block mapped by another heap isn't taken for own one. */
+        constexpr size_t MAPPED_BLOCK_KEY = 0x70614D7061654875ULL; /* "uHeapMap" */
+
+        template <typename Block>
+        inline Block *mappedTag(Block *block, const void *heap)
+        {
+            return reinterpret_cast<Block *>(reinterpret_cast<size_t>(block) ^ reinterpret_cast<size_t>(heap) ^
+                                             MAPPED_BLOCK_KEY);
+        }
+#endif
+
+#ifdef UHEAP_VIRTUAL_MEMORY
+        inline uint64_t monotonicMs()
+        {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            return static_cast<uint64_t>(now.tv_sec) * 1000 + static_cast<uint64_t>(now.tv_nsec) / 1000000;
+        }
+
+        /* Makes reserved memory accessible, pre-faults and locks it if configured.
+         locked is cleared if the memory can't be locked. */
+        inline bool commitPages(uint8_t *begin, size_t size, bool &locked)
+        {
+            if (mprotect(begin, size, PROT_READ | PROT_WRITE) != 0) { return false; }
+    #ifdef UHEAP_VM_PREFAULT
+        #ifdef MADV_POPULATE_WRITE
+            if (madvise(begin, size, MADV_POPULATE_WRITE) != 0)
+        #endif
+            {
+                for (size_t offset = 0; offset < size; offset += pageSize())
+                {
+                    reinterpret_cast<volatile uint8_t *>(begin)[offset] = 0;
+                }
+            }
+    #endif
+    #ifdef UHEAP_VM_MLOCK
+            if (mlock(begin, size) != 0) { locked = false; }
+    #else
+            locked = false;
+    #endif
+            return true;
+        }
+
+        /* Address space of the global heap, only its first part is committed */
+        struct uReservation
+        {
+            uint8_t *region = nullptr;
+            size_t reserved = 0;
+            size_t committed = 0;
+            size_t page = 0;
+            uPageMode mode = uPageMode::region;
+            bool locked = true;
+        };
+
+        /* Reserves max_size bytes and commits the first size of them */
+        inline uReservation reserveHeap(size_t max_size, size_t size)
+        {
+            uReservation result;
+            const size_t reserve = max_size & ~(pageSize() - 1);
+    #if UHEAP_VM_HUGE_PAGES > 0
+            const size_t huge_reserve = reserve & ~(static_cast<size_t>(UHEAP_VM_HUGE_PAGE_SIZE) - 1);
+        #if (UHEAP_VM_HUGE_PAGES > 1) && defined(MAP_HUGETLB)
+            /* Without MAP_NORESERVE a short huge pages pool fails here, not at a page fault */
+            void *huge = (huge_reserve != 0)
+                             ? mmap(nullptr, huge_reserve, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0)
+                             : MAP_FAILED;
+            if (huge != MAP_FAILED)
+            {
+                result.region = static_cast<uint8_t *>(huge);
+                result.mode = uPageMode::explicitHuge;
+            }
+        #endif
+            if ((result.region == nullptr) && (huge_reserve != 0))
+            {
+                /* One more huge page is reserved to start the heap at a huge page boundary */
+                void *region = mmap(nullptr, huge_reserve + UHEAP_VM_HUGE_PAGE_SIZE, PROT_NONE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+                if (region != MAP_FAILED)
+                {
+                    uint8_t *raw = static_cast<uint8_t *>(region);
+                    uint8_t *aligned = reinterpret_cast<uint8_t *>(
+                        alignUp(reinterpret_cast<size_t>(raw), UHEAP_VM_HUGE_PAGE_SIZE));
+                    if (aligned != raw) { munmap(raw, aligned - raw); }
+                    munmap(aligned + huge_reserve, (raw + UHEAP_VM_HUGE_PAGE_SIZE) - aligned);
+                    result.region = aligned;
+                    result.mode = (madvise(aligned, huge_reserve, MADV_HUGEPAGE) == 0)
+                                      ? uPageMode::transparentHuge
+                                      : uPageMode::normal;
+                }
+            }
+            if (result.region != nullptr)
+            {
+                result.reserved = huge_reserve;
+                result.page = UHEAP_VM_HUGE_PAGE_SIZE;
+            }
+    #endif
+            if (result.region == nullptr)
+            {
+                void *region = mmap(nullptr, reserve, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+                if (region == MAP_FAILED) { return result; }
+                result.region = static_cast<uint8_t *>(region);
+                result.reserved = reserve;
+                result.page = pageSize();
+                result.mode = uPageMode::normal;
+            }
+            result.committed = std::min(alignUp(size, result.page), result.reserved);
+            if (!commitPages(result.region, result.committed, result.locked))
+            {
+                munmap(result.region, result.reserved);
+                result = uReservation{};
+            }
+            return result;
+        }
+
+        /* The global heap may be used before dynamic initialization of its user */
+        template <typename Config>
+        uReservation &heapReservation()
+        {
+            static uReservation s_reservation = reserveHeap(Config::maxHeapSize, Config::heapSize);
+            return s_reservation;
+        }
+#else
+        /* Raw heap array of the global heap */
+        template <typename Config>
+        struct uHeapArray
+        {
+            alignas(Config::alignment) static uint8_t data[Config::heapSize];
+        };
+        template <typename Config>
+        alignas(Config::alignment) uint8_t uHeapArray<Config>::data[Config::heapSize] UHEAP_SECTION_INT;
+#endif
+    }  // namespace detail
+
+    template <typename Config>
+    basic_uheap<Config> &basic_uheap<Config>::instance()
+    {
+        static basic_uheap s_instance;
+        return s_instance;
+    }
+
+#ifdef UHEAP_VIRTUAL_MEMORY
+    /* The mapping is never unmapped, blocks may be freed after the static destructors */
+    template <typename Config>
+    basic_uheap<Config>::basic_uheap()
+        : basic_uheap(detail::heapReservation<Config>().region, detail::heapReservation<Config>().committed, true)
+    {
+        if (m_heapSize != 0)
+        {
+            const detail::uReservation &reservation = detail::heapReservation<Config>();
+            m_vmReserved = reservation.reserved;
+            m_vmCommitted = m_heapSize;
+            m_vmPageSize = reservation.page;
+            m_vmPageMode = reservation.mode;
+            m_vmLocked = reservation.locked;
+        }
+#else
+    /* Startup code may leave a custom section uninitialized */
+    template <typename Config>
+    basic_uheap<Config>::basic_uheap()
+    #ifdef UHEAP_SECTION
+        : basic_uheap(detail::uHeapArray<Config>::data, sizeof(detail::uHeapArray<Config>::data))
+    #else
+        : basic_uheap(detail::uHeapArray<Config>::data, sizeof(detail::uHeapArray<Config>::data), true)
+    #endif
+    {
+#endif
+#ifdef UHEAP_THREAD_CACHE
+        m_threadCached = true;
+#endif
+    }
+
+    template <typename Config>
+    basic_uheap<Config>::basic_uheap(void *region, size_t size, bool zeroed)
+    {
+        /* Bigger regions can't be indexed by the free lists */
+        const size_t max_size = ((size_t)1) << FL_INDEX_MAX;
+        m_heapBase = reinterpret_cast<uint8_t *>(region);
+        m_heapSize = (size <= max_size) ? size : max_size;
+
+        /* Ensure the heap starts on a correctly aligned boundary. */
+        size_t aligned_heap = allignBlock(reinterpret_cast<size_t>(m_heapBase));
+        size_t aligned_end = (end() - HeapStructSize) & (~BYTE_ALIGNMENT_MASK);
+        if ((region == nullptr) || (end() < aligned_heap + MINIMUM_BLOCK_SIZE + HeapStructSize) ||
+            (aligned_end < aligned_heap + MINIMUM_BLOCK_SIZE))
+        {
+            /* Region can't hold even one block, the heap stays empty */
+            m_heapSize = 0;
+            heapError();
+            return;
+        }
+
+        /* m_startptr is used to hold a pointer to the physically first block of the heap.*/
+        m_startptr = reinterpret_cast<uBlockLink *>(aligned_heap);
+
+        /* m_endptr is used to mark the end of the heap space. It is marked as allocated so
+         * it never gets merged with the last block. */
+        m_endptr = reinterpret_cast<uBlockLink *>(aligned_end);
+        m_endptr->blockSize = blockAllocatedBit;
+        m_endptr->nextFreeBlock = nullptr;
+
+        /* To start with there is a single free block that is sized to take up the
+         entire heap space, minus the space taken by pxEnd. */
+        m_startptr->blockSize = reinterpret_cast<size_t>(m_endptr) - aligned_heap;
+        m_startptr->nextFreeBlock = nullptr;
+        m_linkFreeBlock(m_startptr);
+
+        m_zeroFrom = reinterpret_cast<uint8_t *>(zeroed ? m_startptr : m_endptr);
+
+        /* Only one block exists - and it covers the entire usable heap space. */
+        m_memoryLowWatermark = m_startptr->blockSize;
+        m_freeBytesRemaining = m_startptr->blockSize;
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::m_mappingInsert(size_t size, size_t &fl, size_t &sl)
+    {
+        if (size < SMALL_BLOCK_SIZE)
+        {
+            /* Small blocks are stored in the first list row */
+            fl = 0;
+            sl = size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT);
+        } else
+        {
+            size_t msb = (sizeof(unsigned long) * BITS_PER_BYTE - 1) - __builtin_clzl(size);
+            sl = (size >> (msb - SL_INDEX_COUNT_LOG2)) ^ (((size_t)1) << SL_INDEX_COUNT_LOG2);
+            fl = msb - (FL_INDEX_SHIFT - 1);
+        }
+    }
+
+    template <typename Config>
+    typename basic_uheap<Config>::uBlockLink *basic_uheap<Config>::m_findFreeBlock(size_t size)
+    {
+        size_t fl, sl;
+        if (uPlacement::exactClass)
+        {
+            /* Blocks of the own class may be smaller than the request */
+            m_mappingInsert(size, fl, sl);
+            if ((fl < FL_INDEX_COUNT) && (m_freeLists[fl][sl] != nullptr))
+            {
+                uBlockLink *block = uPlacement::select(m_freeLists[fl][sl], size, m_rover);
+                if (block != nullptr)
+                {
+                    U_STATS_SEARCH(1);
+                    return block;
+                }
+            }
+        }
+
+        size_t rounded_size = size;
+        if (size >= SMALL_BLOCK_SIZE)
+        {
+            /* Round up to the next class, so any block of the found class fits */
+            size_t msb = (sizeof(unsigned long) * BITS_PER_BYTE - 1) - __builtin_clzl(size);
+            rounded_size += (((size_t)1) << (msb - SL_INDEX_COUNT_LOG2)) - 1;
+        }
+        m_mappingInsert(rounded_size, fl, sl);
+        /* Number of bitmap rows and list heads looked at */
+        size_t steps = uPlacement::exactClass ? 2 : 1;
+        if (fl < FL_INDEX_COUNT)
+        {
+            /* Search for a non-empty list in the same row first */
+            uint32_t sl_map = m_slBitmap[fl] & (~((uint32_t)0) << sl);
+            if (sl_map == 0)
+            {
+                /* No block in this row, take the first non-empty bigger row */
+                ++steps;
+                size_t fl_map =
+                    (fl + 1 < FL_INDEX_COUNT) ? (m_flBitmap & (~((size_t)0) << (fl + 1))) : 0;
+                if (fl_map != 0)
+                {
+                    fl = __builtin_ctzl(fl_map);
+                    sl_map = m_slBitmap[fl];
+                }
+            }
+            if (sl_map != 0)
+            {
+                U_STATS_SEARCH(steps);
+                return uPlacement::select(m_freeLists[fl][__builtin_ctz(sl_map)], size, m_rover);
+            }
+        }
+        U_STATS_SEARCH(steps + 1);
+        if (uPlacement::exactClass) { return nullptr; }
+
+        /* Nothing bigger is left, but the head of the request's own class may still
+         fit. Only the head is checked to keep the search bounded. */
+        m_mappingInsert(size, fl, sl);
+        if ((fl < FL_INDEX_COUNT) && (m_freeLists[fl][sl] != nullptr))
+        {
+            return uPlacement::select(m_freeLists[fl][sl], size, m_rover);
+        }
+        return nullptr;
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::m_linkFreeBlock(uBlockLink *block)
+    {
+        size_t fl, sl;
+        m_mappingInsert(block->size(), fl, sl);
+
+        /* Push the block at the head of its size class list, ordered lists are walked
+         to the first block it goes before */
+        uBlockLink *prev = nullptr;
+        uBlockLink *next = m_freeLists[fl][sl];
+        if (uPlacement::ordered)
+        {
+            while ((next != nullptr) && !uPlacement::before(block, next))
+            {
+                prev = next;
+                next = next->nextFreeBlock;
+            }
+        }
+        block->nextFreeBlock = next;
+        block->prevFreeBlock() = prev;
+        if (next != nullptr) { next->prevFreeBlock() = block; }
+        if (prev != nullptr)
+        {
+            prev->nextFreeBlock = block;
+        } else
+        {
+            m_freeLists[fl][sl] = block;
+        }
+
+        m_flBitmap |= ((size_t)1) << fl;
+        m_slBitmap[fl] |= ((uint32_t)1) << sl;
+
+        /* Let the next block know its neighbour is free */
+        block->setFooter();
+        block->next()->setPrevFree(true);
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::m_unlinkFreeBlock(uBlockLink *block)
+    {
+        size_t fl, sl;
+        m_mappingInsert(block->size(), fl, sl);
+
+        uBlockLink *prev = block->prevFreeBlock();
+        uBlockLink *next = block->nextFreeBlock;
+        if (next != nullptr) { next->prevFreeBlock() = prev; }
+        if (prev != nullptr)
+        {
+            prev->nextFreeBlock = next;
+        } else
+        {
+            /* The block was the list head */
+            m_freeLists[fl][sl] = next;
+            if (next == nullptr)
+            {
+                m_slBitmap[fl] &= ~(((uint32_t)1) << sl);
+                if (m_slBitmap[fl] == 0) { m_flBitmap &= ~(((size_t)1) << fl); }
+            }
+        }
+        block->nextFreeBlock = nullptr;
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::m_insertFreeBlock(uBlockLink *BlockToInsert)
+    {
+        /* Do the block being inserted, and the block physically after it make a
+         contiguous free block of memory? The end marker is always allocated. */
+        size_t merges = 0;
+        uBlockLink *next_block = BlockToInsert->next();
+        if ((next_block->blockSize & blockAllocatedBit) == 0)
+        {
+            /* Form one big block from the two blocks. */
+            m_unlinkFreeBlock(next_block);
+            BlockToInsert->blockSize += next_block->size();
+            ++merges;
+        }
+
+        /* Do the block being inserted, and the block physically before it make a
+         contiguous block of memory? The boundary tag of the previous block gives its
+         address directly. */
+        if ((BlockToInsert->blockSize & blockPrevFreeBit) != 0)
+        {
+            uBlockLink *prev_block = BlockToInsert->prev();
+            m_unlinkFreeBlock(prev_block);
+            /* The released pages of the previous block aren't the only ones now */
+            prev_block->blockSize = (prev_block->blockSize + BlockToInsert->size()) & ~blockZeroedBit;
+            BlockToInsert = prev_block;
+            ++merges;
+        }
+
+        U_STATS_INSERT(merges);
+        (void)merges;
+        m_linkFreeBlock(BlockToInsert);
+    }
+
+    template <typename Config>
+    typename basic_uheap<Config>::uRange basic_uheap<Config>::m_knownZero(uBlockLink *block)
+    {
+        /* Header, list link and boundary tag of the block aren't zero */
+        const size_t block_end = reinterpret_cast<size_t>(block->next()) - sizeof(size_t);
+        uRange range{0, 0};
+        if (reinterpret_cast<uint8_t *>(block->next()) > m_zeroFrom)
+        {
+            /* Only the header of the first free block above m_zeroFrom was left there */
+            uint8_t *begin = (reinterpret_cast<uint8_t *>(block) > m_zeroFrom) ? reinterpret_cast<uint8_t *>(block)
+                                                                                 : m_zeroFrom;
+            range = {reinterpret_cast<size_t>(begin) + HeapStructSize + sizeof(uBlockLink *), block_end};
+        }
+#ifdef UHEAP_VIRTUAL_MEMORY
+        if ((block->blockSize & blockZeroedBit) != 0)
+        {
+            /* Released pages join the never allocated end if they reach it */
+            const size_t first = (reinterpret_cast<size_t>(block->block()) + sizeof(uBlockLink *) + m_vmPageSize - 1) &
+                                 ~(m_vmPageSize - 1);
+            const size_t last = block_end & ~(m_vmPageSize - 1);
+            if ((range.begin >= range.end) || (last < range.begin))
+            {
+                if ((last > first) && ((range.begin >= range.end) || (last - first > range.end - range.begin)))
+                {
+                    range = {first, last};
+                }
+            } else if (first < range.begin)
+            {
+                range.begin = first;
+            }
+        }
+#endif
+        return range;
+    }
+
+    template <typename Config>
+    void *basic_uheap<Config>::m_useBlock(uBlockLink *p_block, size_t new_size)
+    {
+        uBlockLink *p_new_block_link;
+
+        /* If the block is larger than required it can be split into
+               two. */
+        if ((p_block->size() - new_size) > MINIMUM_BLOCK_SIZE)
+        {
+            /* This block is to be split into two.  Create a new
+                     block following the number of bytes requested. The void
+                     cast is used to prevent byte alignment warnings from the
+                     compiler. */
+            p_new_block_link =
+                reinterpret_cast<uBlockLink *>((reinterpret_cast<uint8_t *>(p_block)) + new_size);
+            userheapASSERT((((size_t)p_new_block_link) & BYTE_ALIGNMENT_MASK) == 0);
+
+            /* Calculate the sizes of two blocks split from the
+                     single block. */
+            p_new_block_link->blockSize = (p_block->size() - new_size) | (p_block->blockSize & blockZeroedBit);
+            p_block->blockSize = new_size | (p_block->blockSize & blockFlagsMask);
+
+            /* Insert the new block into the free lists. Both its neighbours
+                     are in use, so there is nothing to merge. */
+            m_linkFreeBlock(p_new_block_link);
+        } else
+        {
+            /* The whole block is used, the next one has no free neighbour now */
+            p_block->next()->setPrevFree(false);
+        }
+
+        m_freeBytesRemaining -= p_block->size();
+
+        if (m_freeBytesRemaining < m_memoryLowWatermark)
+        {
+            m_memoryLowWatermark = m_freeBytesRemaining;
+        }
+
+        /* The block is being returned - it is allocated and owned
+               by the application and has no "next" block. */
+        p_block->blockSize = (p_block->blockSize | blockAllocatedBit) & ~blockZeroedBit;
+        p_block->nextFreeBlock = nullptr;
+        if (reinterpret_cast<uint8_t *>(p_block->next()) > m_zeroFrom)
+        {
+            m_zeroFrom = reinterpret_cast<uint8_t *>(p_block->next());
+        }
+        if (uPlacement::roving) { m_rover = p_block->next(); }
+
+        /* Return the memory space pointed to - jumping over the
+               BlockLink_t structure at its start. */
+        return reinterpret_cast<void *>(p_block->block());
+    }
+
+    template <typename Config>
+    size_t basic_uheap<Config>::m_carveBlock(uBlockLink *p_block, size_t new_size, size_t count, void **out)
+    {
+        const size_t block_size = p_block->size();
+        const size_t prev_free = p_block->blockSize & blockPrevFreeBit;
+        const size_t zeroed = p_block->blockSize & blockZeroedBit;
+        size_t carved = block_size / new_size;
+        if (carved > count) { carved = count; }
+
+        uint8_t *p_raw = reinterpret_cast<uint8_t *>(p_block);
+        uBlockLink *p_last = nullptr;
+        for (size_t i = 0; i < carved; ++i)
+        {
+            p_last = reinterpret_cast<uBlockLink *>(p_raw + i * new_size);
+            p_last->blockSize = new_size | blockAllocatedBit;
+            p_last->nextFreeBlock = nullptr;
+            out[i] = p_last->block();
+            U_STATS_ALLOCATION(new_size - HeapStructSize);
+        }
+        /* Only the first block keeps the state of its physical neighbour */
+        p_block->blockSize |= prev_free;
+
+        /* The tail is split off by the same rule as in m_useBlock */
+        size_t used_size = carved * new_size;
+        if ((block_size - used_size) > MINIMUM_BLOCK_SIZE)
+        {
+            uBlockLink *p_tail = reinterpret_cast<uBlockLink *>(p_raw + used_size);
+            p_tail->blockSize = (block_size - used_size) | zeroed;
+            p_tail->nextFreeBlock = nullptr;
+            m_linkFreeBlock(p_tail);
+        } else
+        {
+            p_last->blockSize += block_size - used_size;
+            p_last->next()->setPrevFree(false);
+            used_size = block_size;
+        }
+
+        if (p_raw + used_size > m_zeroFrom) { m_zeroFrom = p_raw + used_size; }
+        m_freeBytesRemaining -= used_size;
+        if (m_freeBytesRemaining < m_memoryLowWatermark) { m_memoryLowWatermark = m_freeBytesRemaining; }
+        return carved;
+    }
+
+    template <typename Config>
+    void *basic_uheap<Config>::m_malloc(size_t new_size, uRange *zero)
+    {
+        uBlockLink *p_block;
+        void *p_return = nullptr;
+        if (new_size == 0) { return nullptr; }
+        m_drainDeferred();
+        U_STATS_ALLOCATION(new_size);
+        if ((new_size > m_availableBytes()) || (m_availableBytes() < MINIMUM_BLOCK_SIZE))
+        {
+            heapFull();
+            return nullptr;
+        }
+        // TODO: this scope must be in a Critical Section
+
+        /* The wanted size is increased so it can contain a BlockLink_t
+           structure in addition to the requested amount of bytes. */
+        new_size += HeapStructSize;
+
+        /* Ensure that blocks are always aligned to the required number of bytes. */
+        if ((new_size & BYTE_ALIGNMENT_MASK) != 0x00)
+        {
+            /* Byte alignment required. */
+            new_size += (BYTE_ALIGNMENT - (new_size & BYTE_ALIGNMENT_MASK));
+            userheapASSERT((new_size & BYTE_ALIGNMENT_MASK) == 0);
+        }
+
+        if ((new_size > 0) && (new_size <= m_availableBytes()))
+        {
+            /* Take the head of the smallest non-empty size class that fits. */
+            p_block = m_findFreeBlock(new_size);
+            if ((p_block == nullptr) && m_grow(new_size)) { p_block = m_findFreeBlock(new_size); }
+
+            /* If no class was found then a block of adequate size
+                 was	not found. */
+            if (p_block != nullptr)
+            {
+                /* This block is being returned for use so must be taken out
+                       of the list of free blocks. */
+                m_unlinkFreeBlock(p_block);
+                if (zero != nullptr) { *zero = m_knownZero(p_block); }
+                p_return = m_useBlock(p_block, new_size);
+            } else
+            {
+                heapFull();
+            }
+        }
+        // TODO: this scope must be in a Critical Section
+        userheapASSERT((((size_t)p_return) & (size_t)BYTE_ALIGNMENT_MASK) == 0);
+        return p_return;
+    }
+
+    template <typename Config>
+    void *basic_uheap<Config>::m_mallocAligned(size_t new_size, size_t alignment)
+    {
+        if (new_size == 0) { return nullptr; }
+        m_drainDeferred();
+        U_STATS_ALLOCATION(new_size);
+        if ((new_size > m_availableBytes()) || (alignment > m_availableBytes()))
+        {
+            heapFull();
+            return nullptr;
+        }
+        new_size = allignBlock(new_size + HeapStructSize);
+
+        /* Any block of this size has an aligned address with enough room for a
+         free block in front of it */
+        uBlockLink *p_block = m_findFreeBlock(new_size + alignment + MINIMUM_BLOCK_SIZE);
+        if ((p_block == nullptr) && m_grow(new_size + alignment + MINIMUM_BLOCK_SIZE))
+        {
+            p_block = m_findFreeBlock(new_size + alignment + MINIMUM_BLOCK_SIZE);
+        }
+        if (p_block == nullptr)
+        {
+            heapFull();
+            return nullptr;
+        }
+        m_unlinkFreeBlock(p_block);
+
+        /* Leading slack must be either empty or big enough to be a free block */
+        size_t payload = reinterpret_cast<size_t>(p_block->block());
+        size_t slack = ((payload + alignment - 1) & ~(alignment - 1)) - payload;
+        if ((slack != 0) && (slack < MINIMUM_BLOCK_SIZE)) { slack += alignment; }
+
+        if (slack != 0)
+        {
+            /* Carve the aligned block out and return the slack to the free lists.
+             The block before the slack is in use, nothing to merge. */
+            uBlockLink *p_aligned =
+                reinterpret_cast<uBlockLink *>(reinterpret_cast<uint8_t *>(p_block) + slack);
+            p_aligned->blockSize = p_block->size() - slack;
+            p_block->blockSize = slack;
+            m_linkFreeBlock(p_block);
+            p_block = p_aligned;
+        }
+        return m_useBlock(p_block, new_size);
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::m_free(void *pv)
+    {
+        if (pv == nullptr) { return; }
+        if (!isOwned(pv))
+        {
+            /* Not a heap block, or a block mapped by another heap */
+            heapError();
+            return;
+        }
+
+        /* The memory being freed will have an uBlockLink structure immediately
+         before it. */
+        uBlockLink *p_link =
+            reinterpret_cast<uBlockLink *>(reinterpret_cast<uint8_t *>(pv) - HeapStructSize);
+
+        /* Check the block is actually allocated. */
+        if ((p_link->blockSize & blockAllocatedBit) == 0)
+        {
+            return;  // TODO: Must cause "double free or corrupted"
+        }
+        if (p_link->nextFreeBlock != nullptr)
+        {
+            return;  // TODO: Must cause "double free or corrupted"
+        }
+
+        /* The block is being returned to the heap - it is no longer
+             allocated. */
+        p_link->blockSize &= ~blockAllocatedBit;
+        U_STATS_DEALLOCATION();
+        {
+            /* Add this block to the list of free blocks. */
+            m_freeBytesRemaining += p_link->size();
+            U_VM_DIRTY(p_link->size());
+            m_insertFreeBlock(p_link);
+        }
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::m_deferFree(void *pv)
+    {
+        /* Compiled only with deferred free, the lock needs try_lock() then */
+        if constexpr (Config::deferredFree)
+        {
+            /* Same checks as in m_free, the caller still owns the block */
+            uBlockLink *p_link = m_allocatedBlock(pv);
+            if (p_link == nullptr)
+            {
+                if ((pv != nullptr) && !isOwned(pv)) { heapError(); }
+                return;
+            }
+
+            /* Blocks are only pushed, the whole list is taken at once, so there is no ABA */
+            uBlockLink *head = m_deferred.load(std::memory_order_relaxed);
+            do
+            {
+                p_link->nextFreeBlock = (head != nullptr) ? head : reinterpret_cast<uBlockLink *>(this);
+            } while (
+                !m_deferred.compare_exchange_weak(head, p_link, std::memory_order_release, std::memory_order_relaxed));
+
+            /* Nobody allocates, free the list here rather than let it grow */
+            if ((m_deferredCount.fetch_add(1, std::memory_order_relaxed) + 1 >= Config::deferredFreeThreshold) &&
+                m_lock.try_lock())
+            {
+                m_drainDeferred();
+                m_lock.unlock();
+            }
+        }
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::m_drainDeferred()
+    {
+        if constexpr (Config::deferredFree)
+        {
+            if (m_deferred.load(std::memory_order_relaxed) == nullptr) { return; }
+            uBlockLink *block = m_deferred.exchange(nullptr, std::memory_order_acquire);
+            size_t count = 0;
+            while (block != nullptr)
+            {
+                uBlockLink *next = block->nextFreeBlock;
+                block->nextFreeBlock = nullptr;
+                m_free(block->block());
+                ++count;
+                block = (next != reinterpret_cast<uBlockLink *>(this)) ? next : nullptr;
+            }
+            m_deferredCount.fetch_sub(count, std::memory_order_relaxed);
+        }
+    }
+
+    template <typename Config>
+    typename basic_uheap<Config>::uBlockLink *basic_uheap<Config>::m_allocatedBlock(void *pv)
+    {
+        if ((pv == nullptr) || !isOwned(pv)) { return nullptr; }
+        uBlockLink *p_link =
+            reinterpret_cast<uBlockLink *>(reinterpret_cast<uint8_t *>(pv) - HeapStructSize);
+        if (((p_link->header() & blockAllocatedBit) == 0) || (p_link->nextFreeBlock != nullptr))
+        {
+            return nullptr;
+        }
+        return p_link;
+    }
+
+    template <typename Config>
+    bool basic_uheap<Config>::m_resize(uBlockLink *block, size_t new_size)
+    {
+        const size_t flags = block->blockSize & blockFlagsMask;
+        const size_t current_size = block->size();
+        /* Same guard as in m_malloc, the rounding below would wrap around for huge sizes */
+        if (new_size > current_size + m_availableBytes()) { return false; }
+        new_size = allignBlock(new_size + HeapStructSize);
+        if (new_size < MINIMUM_BLOCK_SIZE) { new_size = MINIMUM_BLOCK_SIZE; }
+
+        if (new_size > current_size)
+        {
+            /* Grow into the next block if it is free and big enough */
+            uBlockLink *next_block = block->next();
+            if (((next_block->blockSize & blockAllocatedBit) != 0) ||
+                ((current_size + next_block->size()) < new_size))
+            {
+                return false;
+            }
+            m_unlinkFreeBlock(next_block);
+            m_freeBytesRemaining -= next_block->size();
+            block->blockSize = (current_size + next_block->size()) | flags;
+            block->next()->setPrevFree(false);
+        }
+
+        /* Give back the tail if it is big enough, same rule as in m_malloc */
+        if ((block->size() - new_size) > MINIMUM_BLOCK_SIZE)
+        {
+            uBlockLink *tail = reinterpret_cast<uBlockLink *>(reinterpret_cast<uint8_t *>(block) + new_size);
+            tail->blockSize = block->size() - new_size;
+            tail->nextFreeBlock = nullptr;
+            block->blockSize = new_size | flags;
+            m_freeBytesRemaining += tail->size();
+            m_insertFreeBlock(tail);
+        }
+
+        if (reinterpret_cast<uint8_t *>(block->next()) > m_zeroFrom)
+        {
+            m_zeroFrom = reinterpret_cast<uint8_t *>(block->next());
+        }
+        if (m_freeBytesRemaining < m_memoryLowWatermark) { m_memoryLowWatermark = m_freeBytesRemaining; }
+        return true;
+    }
+
+#ifdef UHEAP_VIRTUAL_MEMORY
+    template <typename Config>
+    bool basic_uheap<Config>::m_grow(size_t size)
+    {
+        if (m_vmReserved == 0) { return false; }
+
+        /* Only the missing part is needed if the last block is free */
+        const size_t last_free =
+            ((m_endptr->blockSize & blockPrevFreeBit) != 0) ? m_endptr->prev()->size() : 0;
+        const size_t needed = (size > last_free) ? (size - last_free) : 0;
+        size_t step = detail::alignUp((needed > UHEAP_VM_COMMIT_STEP) ? needed : UHEAP_VM_COMMIT_STEP, m_vmPageSize);
+        if (step > m_vmReserved - m_vmCommitted) { step = m_vmReserved - m_vmCommitted; }
+        if ((step == 0) || (step < needed)) { return false; }
+        if (!detail::commitPages(m_heapBase + m_vmCommitted, step, m_vmLocked)) { return false; }
+        m_vmCommitted += step;
+        m_heapSize += step;
+
+        /* The end marker becomes the new block, a new marker is placed behind it */
+        uBlockLink *p_block = m_endptr;
+        const bool merged = (p_block->blockSize & blockPrevFreeBit) != 0;
+        p_block->blockSize = step | (p_block->blockSize & blockPrevFreeBit);
+        p_block->nextFreeBlock = nullptr;
+        m_endptr = p_block->next();
+        m_endptr->blockSize = blockAllocatedBit;
+        m_endptr->nextFreeBlock = nullptr;
+
+        /* The used high-water mark (capacity - low watermark) doesn't change */
+        m_freeBytesRemaining += step;
+        m_memoryLowWatermark += step;
+        m_insertFreeBlock(p_block);
+
+        /* The old marker and boundary tag are inside the last block now, they are
+         cleared so the end of the heap stays zero */
+        if (merged)
+        {
+            memset(reinterpret_cast<uint8_t *>(p_block) - sizeof(size_t), 0, sizeof(size_t) + HeapStructSize);
+        }
+        return true;
+    }
+
+    template <typename Config>
+    size_t basic_uheap<Config>::m_trim()
+    {
+        /* Locked pages can't be released, released explicit huge pages may be taken by
+         someone else and fault with SIGBUS later */
+        if ((m_vmReserved == 0) || m_vmLocked || (m_vmPageMode == uPageMode::explicitHuge)) { return 0; }
+        m_drainDeferred();
+        size_t released = 0;
+        for (size_t fl = 0; fl < FL_INDEX_COUNT; ++fl)
+        {
+            for (size_t sl = 0; sl < SL_INDEX_COUNT; ++sl)
+            {
+                for (uBlockLink *block = m_freeLists[fl][sl]; block != nullptr; block = block->nextFreeBlock)
+                {
+                    if (block->size() < UHEAP_VM_TRIM_THRESHOLD) { continue; }
+
+                    /* Keep the header, the list back link and the boundary tag */
+                    size_t first =
+                        detail::alignUp(reinterpret_cast<size_t>(block->block()) + sizeof(uBlockLink *), m_vmPageSize);
+                    size_t last = (reinterpret_cast<size_t>(block->next()) - sizeof(size_t)) & ~(m_vmPageSize - 1);
+                    if ((last > first) && (madvise(reinterpret_cast<void *>(first), last - first, MADV_DONTNEED) == 0))
+                    {
+                        released += last - first;
+                        block->blockSize |= blockZeroedBit;
+                    }
+                }
+            }
+        }
+        m_vmDirtyBytes = 0;
+        return released;
+    }
+#else
+    template <typename Config>
+    bool basic_uheap<Config>::m_grow(size_t) { return false; }
+
+    template <typename Config>
+    size_t basic_uheap<Config>::m_trim() { return 0; }
+#endif
+
+    template <typename Config>
+    size_t basic_uheap<Config>::trim()
+    {
+        // LOCK (unlocked at scope exit)
+        uGuard trim_guard(m_lock);
+        return m_trim();
+    }
+
+    template <typename Config>
+    size_t basic_uheap<Config>::decay()
+    {
+#ifdef UHEAP_VIRTUAL_MEMORY
+        // LOCK (unlocked at scope exit)
+        uGuard decay_guard(m_lock);
+        if (m_vmDirtyBytes < UHEAP_VM_TRIM_THRESHOLD)
+        {
+            m_vmDirtySince = 0;
+            return 0;
+        }
+        const uint64_t now = detail::monotonicMs();
+        if (m_vmDirtySince == 0)
+        {
+            m_vmDirtySince = now;
+            return 0;
+        }
+        if (now - m_vmDirtySince < UHEAP_VM_DECAY_MS) { return 0; }
+        m_vmDirtySince = 0;
+        return m_trim();
+#else
+        return 0;
+#endif
+    }
+
+#ifdef UHEAP_MMAP_THRESHOLD
+    template <typename Config>
+    void *basic_uheap<Config>::m_mapBlock(size_t new_size)
+    {
+        if (new_size > (SIZE_MAX >> 1)) { return nullptr; }
+        const size_t map_size = detail::alignUp(new_size + HeapStructSize, detail::pageSize());
+        void *region = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) { return nullptr; }
+
+        uBlockLink *p_block = reinterpret_cast<uBlockLink *>(region);
+        p_block->blockSize = map_size | blockAllocatedBit;
+        p_block->nextFreeBlock = detail::mappedTag(p_block, this);
+        m_countMapped(1, static_cast<ptrdiff_t>(map_size));
+        return p_block->block();
+    }
+
+    template <typename Config>
+    typename basic_uheap<Config>::uBlockLink *basic_uheap<Config>::m_mappedBlock(void *pv)
+    {
+        /* The header is read only if it is in the page of the payload */
+        if ((pv == nullptr) || isOwned(pv) ||
+            ((reinterpret_cast<size_t>(pv) & (detail::pageSize() - 1)) != HeapStructSize))
+        {
+            return nullptr;
+        }
+        uBlockLink *p_block = reinterpret_cast<uBlockLink *>(reinterpret_cast<uint8_t *>(pv) - HeapStructSize);
+        return (p_block->nextFreeBlock == detail::mappedTag(p_block, this)) ? p_block : nullptr;
+    }
+
+    template <typename Config>
+    bool basic_uheap<Config>::m_unmapBlock(void *pv)
+    {
+        uBlockLink *p_block = m_mappedBlock(pv);
+        if (p_block == nullptr) { return false; }
+        const size_t map_size = p_block->size();
+        munmap(p_block, map_size);
+        m_countMapped(-1, -static_cast<ptrdiff_t>(map_size));
+        return true;
+    }
+
+    template <typename Config>
+    void *basic_uheap<Config>::m_remapBlock(uBlockLink *block, size_t new_size, bool may_move)
+    {
+    #ifdef MREMAP_MAYMOVE
+        if (new_size > (SIZE_MAX >> 1)) { return nullptr; }
+        const size_t old_size = block->size();
+        const size_t map_size = detail::alignUp(new_size + HeapStructSize, detail::pageSize());
+        void *region = mremap(block, old_size, map_size, may_move ? MREMAP_MAYMOVE : 0);
+        if (region == MAP_FAILED) { return nullptr; }
+
+        /* The tag depends on the address */
+        uBlockLink *p_block = reinterpret_cast<uBlockLink *>(region);
+        p_block->blockSize = map_size | blockAllocatedBit;
+        p_block->nextFreeBlock = detail::mappedTag(p_block, this);
+        m_countMapped(0, static_cast<ptrdiff_t>(map_size) - static_cast<ptrdiff_t>(old_size));
+        return p_block->block();
+    #else
+        /* No mremap, reallocate moves the block by copying */
+        (void)block;
+        (void)new_size;
+        (void)may_move;
+        return nullptr;
+    #endif
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::m_countMapped(ptrdiff_t blocks, ptrdiff_t bytes)
+    {
+        // LOCK (unlocked at scope exit)
+        uGuard map_guard(m_lock);
+        m_mappedBlocks += static_cast<size_t>(blocks);
+        m_mappedBytes += static_cast<size_t>(bytes);
+    }
+#endif
+
+    template <typename Config>
+    const size_t& basic_uheap<Config>::getFreeBytesRemaining() const { return m_freeBytesRemaining; }
+
+    template <typename Config>
+    const size_t& basic_uheap<Config>::getMemoryLowWatermark() const { return m_memoryLowWatermark; }
+
+    template <typename Config>
+    typename basic_uheap<Config>::uStats basic_uheap<Config>::stats()
+    {
+        // LOCK (unlocked at scope exit)
+        uGuard stats_guard(m_lock);
+        m_drainDeferred();
+        uStats result{};
+        if constexpr (Config::stats) { result = m_counters; }
+        result.capacity = m_heapSize;
+        result.freeBytes = m_freeBytesRemaining;
+        result.lowWatermark = m_memoryLowWatermark;
+        result.largestFreeBlock = 0;
+        result.freeBlocks = 0;
+#ifdef UHEAP_MMAP_THRESHOLD
+        result.mappedBlocks = m_mappedBlocks;
+        result.mappedBytes = m_mappedBytes;
+#endif
+#ifdef UHEAP_VIRTUAL_MEMORY
+        result.pageMode = m_vmPageMode;
+        result.locked = m_vmLocked;
+    #ifdef UHEAP_VM_PREFAULT
+        result.prefaulted = (m_vmReserved != 0);
+    #endif
+#endif
+        for (size_t fl = 0; fl < FL_INDEX_COUNT; ++fl)
+        {
+            for (size_t sl = 0; sl < SL_INDEX_COUNT; ++sl)
+            {
+                for (uBlockLink *block = m_freeLists[fl][sl]; block != nullptr; block = block->nextFreeBlock)
+                {
+                    ++result.freeBlocks;
+                    if (block->size() > result.largestFreeBlock) { result.largestFreeBlock = block->size(); }
+                }
+            }
+        }
+        return result;
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::dump(uDumpWriter writer, void *context)
+    {
+        if (writer == nullptr) { return; }
+        const size_t first_block =
+            (m_startptr != nullptr) ? reinterpret_cast<size_t>(m_startptr) - reinterpret_cast<size_t>(m_heapBase) : 0;
+        uHeapDumpHeader header{};
+        header.magic = UHEAP_DUMP_MAGIC;
+        header.version = UHEAP_DUMP_VERSION;
+        header.granularity = BYTE_ALIGNMENT;
+        header.heapBase = reinterpret_cast<size_t>(m_heapBase);
+        header.heapSize = m_heapSize;
+        header.firstBlock = first_block;
+        header.freeBytes = m_freeBytesRemaining;
+        header.lowWatermark = m_memoryLowWatermark;
+        writer(&header, sizeof(header), context);
+
+        /* Records are collected on the stack, the heap may be full or broken */
+        uint32_t records[32];
+        size_t count = 0;
+        auto record = [&](const uBlockInfo &info) {
+            /* Blocks too big for one record are split into continued records */
+            uint64_t units = info.size / BYTE_ALIGNMENT;
+            do
+            {
+                const uint64_t part = (units > UHEAP_DUMP_MAX_UNITS) ? UHEAP_DUMP_MAX_UNITS : units;
+                units -= part;
+                records[count++] = uHeapDumpRecord(part, info.allocated, units != 0);
+                if (count == sizeof(records) / sizeof(records[0]))
+                {
+                    writer(records, sizeof(records), context);
+                    count = 0;
+                }
+            } while (units != 0);
+        };
+        m_walk(record);
+        records[count++] = 0;
+        writer(records, count * sizeof(records[0]), context);
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::m_countAllocation(size_t size)
+    {
+        if constexpr (Config::stats)
+        {
+            ++m_counters.allocations;
+            ++m_counters.sizeHistogram[(sizeof(unsigned long) * BITS_PER_BYTE - 1) - __builtin_clzl(size)];
+        }
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::m_countDeallocation()
+    {
+        if constexpr (Config::stats) { ++m_counters.deallocations; }
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::m_countSearch(size_t steps)
+    {
+        if constexpr (Config::stats)
+        {
+            m_countSteps(m_counters.searches, m_counters.searchSteps, m_counters.maxSearchSteps, steps);
+        }
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::m_countInsert(size_t merges)
+    {
+        if constexpr (Config::stats)
+        {
+            m_countSteps(m_counters.inserts, m_counters.insertMerges, m_counters.maxInsertMerges, merges);
+        }
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::m_countSteps(size_t &count, size_t &total, size_t &max, size_t steps)
+    {
+        ++count;
+        total += steps;
+        if (steps > max) { max = steps; }
+    }
+
+    template <typename Config>
+    void *basic_uheap<Config>::allocate(size_t new_size)
+    {
+#ifdef UHEAP_THREAD_CACHE
+        if ((new_size != 0) && (new_size <= UHEAP_THREAD_CACHE_MAX_SIZE))
+        {
+            uThreadCache &cache = uThreadCache::local();
+            if (cache.accepts(*this))
+            {
+                void *temp = cache.allocate(*this, new_size);
+                U_TRACE(allocate, temp, new_size, nullptr);
+                return temp;
+            }
+        }
+#endif
+#ifdef UHEAP_MMAP_THRESHOLD
+        if (new_size >= UHEAP_MMAP_THRESHOLD)
+        {
+            /* The heap is the fallback if the OS has nothing to map */
+            void *mapped = m_mapBlock(new_size);
+            if (mapped != nullptr)
+            {
+                U_TRACE(allocate, mapped, new_size, nullptr);
+                return mapped;
+            }
+        }
+#endif
+        void *temp;
+        {
+            // LOCK (unlocked at scope exit)
+            uGuard alloc_guard(m_lock);
+            temp = m_malloc(new_size);
+
+            U_DEBUG_ALLOCATE(new_size, m_freeBytesRemaining, m_memoryLowWatermark);
+        }
+        /* Nobody else knows the block yet, so it is traced out of the lock */
+        U_TRACE(allocate, temp, new_size, nullptr);
+        return temp;
+    }
+
+    template <typename Config>
+    void *basic_uheap<Config>::allocate_zeroed(size_t count, size_t size)
+    {
+        if ((size != 0) && (count > SIZE_MAX / size))
+        {
+            // LOCK (unlocked at scope exit)
+            uGuard zeroed_guard(m_lock);
+            heapFull();
+            return nullptr;
+        }
+        const size_t new_size = count * size;
+#ifdef UHEAP_THREAD_CACHE
+        /* Cached blocks are dirty anyway */
+        if (new_size <= UHEAP_THREAD_CACHE_MAX_SIZE)
+        {
+            void *temp = allocate(new_size);
+            if (temp != nullptr) { memset(temp, 0, new_size); }
+            return temp;
+        }
+#endif
+#ifdef UHEAP_MMAP_THRESHOLD
+        if (new_size >= UHEAP_MMAP_THRESHOLD)
+        {
+            /* A new mapping is zero */
+            void *mapped = m_mapBlock(new_size);
+            if (mapped != nullptr)
+            {
+                U_TRACE(allocate, mapped, new_size, nullptr);
+                return mapped;
+            }
+        }
+#endif
+        void *temp;
+        uRange zero{0, 0};
+        {
+            // LOCK (unlocked at scope exit)
+            uGuard alloc_guard(m_lock);
+            temp = m_malloc(new_size, &zero);
+
+            U_DEBUG_ALLOCATE(new_size, m_freeBytesRemaining, m_memoryLowWatermark);
+        }
+        U_TRACE(allocate, temp, new_size, nullptr);
+        if (temp == nullptr) { return nullptr; }
+
+        /* Clear only the payload out of the known zero range */
+        const size_t begin = reinterpret_cast<size_t>(temp);
+        const size_t end = begin + new_size;
+        size_t zero_begin = (zero.begin > begin) ? zero.begin : begin;
+        size_t zero_end = (zero.end < end) ? zero.end : end;
+        if (zero_begin >= zero_end) { zero_begin = zero_end = end; }
+        memset(temp, 0, zero_begin - begin);
+        memset(reinterpret_cast<void *>(zero_end), 0, end - zero_end);
+        return temp;
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::deallocate(void *pv)
+    {
+        /* Traced before the block can be reused by another thread */
+        U_TRACE(deallocate, pv, 0, nullptr);
+#ifdef UHEAP_MMAP_THRESHOLD
+        if (m_unmapBlock(pv)) { return; }
+#endif
+#ifdef UHEAP_THREAD_CACHE
+        uThreadCache &cache = uThreadCache::local();
+        if (cache.accepts(*this) && cache.deallocate(*this, pv)) { return; }
+#endif
+        if constexpr (Config::deferredFree)
+        {
+            m_deferFree(pv);
+            return;
+        }
+        // LOCK (unlocked at scope exit)
+        uGuard dealloc_guard(m_lock);
+        m_free(pv);
+
+        U_DEBUG_DEALLOCATE(m_freeBytesRemaining, m_memoryLowWatermark);
+    }
+
+#ifdef UHEAP_THREAD_CACHE
+    template <typename Config>
+    typename basic_uheap<Config>::uThreadCache &basic_uheap<Config>::uThreadCache::local()
+    {
+        static thread_local uThreadCache s_cache;
+        return s_cache;
+    }
+
+    template <typename Config>
+    basic_uheap<Config>::uThreadCache::~uThreadCache()
+    {
+        flush();
+        /* Blocks freed by other thread_local destructors go directly to the heap */
+        m_disabled = true;
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::uThreadCache::m_push(size_t bin, uBlockLink *block)
+    {
+        block->nextFreeBlock = (m_bins[bin] != nullptr) ? m_bins[bin] : reinterpret_cast<uBlockLink *>(m_heap);
+        m_bins[bin] = block;
+        ++m_counts[bin];
+    }
+
+    template <typename Config>
+    typename basic_uheap<Config>::uBlockLink *basic_uheap<Config>::uThreadCache::m_pop(size_t bin)
+    {
+        uBlockLink *block = m_bins[bin];
+        if (block == nullptr) { return nullptr; }
+        m_bins[bin] =
+            (block->nextFreeBlock != reinterpret_cast<uBlockLink *>(m_heap)) ? block->nextFreeBlock : nullptr;
+        block->nextFreeBlock = nullptr;
+        --m_counts[bin];
+        return block;
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::uThreadCache::m_refill(size_t bin, size_t new_size)
+    {
+        // LOCK (unlocked at scope exit)
+        uGuard refill_guard(m_heap->m_lock);
+        for (size_t i = 0; i < BATCH; ++i)
+        {
+            /* Only the first block may report the full heap, the rest of the batch
+             is optional */
+            if ((i != 0) && (m_heap->m_findFreeBlock(m_heap->allignBlock(new_size + HeapStructSize)) == nullptr))
+            {
+                break;
+            }
+            void *pv = m_heap->m_malloc(new_size);
+            if (pv == nullptr) { break; }
+            m_push(bin, reinterpret_cast<uBlockLink *>(reinterpret_cast<uint8_t *>(pv) - HeapStructSize));
+        }
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::uThreadCache::m_release(size_t bin, size_t count)
+    {
+        // LOCK (unlocked at scope exit)
+        uGuard release_guard(m_heap->m_lock);
+        while (count-- != 0)
+        {
+            uBlockLink *block = m_pop(bin);
+            if (block == nullptr) { break; }
+            m_heap->m_free(block->block());
+        }
+    }
+
+    template <typename Config>
+    void *basic_uheap<Config>::uThreadCache::allocate(basic_uheap &heap, size_t new_size)
+    {
+        m_heap = &heap;
+        size_t bin = (heap.allignBlock(new_size + HeapStructSize) - MINIMUM_BLOCK_SIZE) / BYTE_ALIGNMENT;
+        if (m_bins[bin] == nullptr) { m_refill(bin, new_size); }
+        uBlockLink *block = m_pop(bin);
+        return (block != nullptr) ? block->block() : nullptr;
+    }
+
+    template <typename Config>
+    bool basic_uheap<Config>::uThreadCache::deallocate(basic_uheap &heap, void *pv, size_t size)
+    {
+        /* Not allocated or already cached blocks are left to m_free checks */
+        uBlockLink *p_link = heap.m_allocatedBlock(pv);
+        if (p_link == nullptr) { return false; }
+
+        /* The caller-known size picks the bin without decoding the header. Unsplit
+         blocks may be slightly bigger than their bin, that's fine for reuse. */
+        size_t block_size = (size != 0) ? heap.allignBlock(size + HeapStructSize) : p_link->headerSize();
+        if (block_size < MINIMUM_BLOCK_SIZE) { block_size = MINIMUM_BLOCK_SIZE; }
+        if (block_size > MAX_BLOCK_SIZE) { return false; }
+
+        m_heap = &heap;
+        size_t bin = (block_size - MINIMUM_BLOCK_SIZE) / BYTE_ALIGNMENT;
+        m_push(bin, p_link);
+        if (m_counts[bin] > (BATCH << 1)) { m_release(bin, BATCH); }
+        return true;
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::uThreadCache::flush()
+    {
+        if (m_heap == nullptr) { return; }
+        for (size_t bin = 0; bin < BIN_COUNT; ++bin)
+        {
+            if (m_counts[bin] != 0) { m_release(bin, m_counts[bin]); }
+        }
+    }
+#endif
+
+    template <typename Config>
+    void basic_uheap<Config>::deallocate(void *pv, size_t size)
+    {
+        if (size == 0) { return deallocate(pv); }
+#ifdef UHEAP_MMAP_THRESHOLD
+        /* Only blocks of big requests may be mapped */
+        if ((size >= UHEAP_MMAP_THRESHOLD) && (m_mappedBlock(pv) != nullptr))
+        {
+            U_TRACE(deallocate, pv, size, nullptr);
+            m_unmapBlock(pv);
+            return;
+        }
+#endif
+#ifdef UHEAP_DEBUG_CHECKS
+        if (!m_checkBlockSize(pv, size))
+        {
+            heapError();
+            return;
+        }
+#endif
+        U_TRACE(deallocate, pv, size, nullptr);
+#ifdef UHEAP_THREAD_CACHE
+        /* Big blocks skip the thread cache lookup */
+        if (size <= UHEAP_THREAD_CACHE_MAX_SIZE)
+        {
+            uThreadCache &cache = uThreadCache::local();
+            if (cache.accepts(*this) && cache.deallocate(*this, pv, size)) { return; }
+        }
+#endif
+        if constexpr (Config::deferredFree)
+        {
+            m_deferFree(pv);
+            return;
+        }
+        /* The block may keep an unsplit tail of up to MINIMUM_BLOCK_SIZE bytes and may have
+         been resized, so its size and class for the merge come from the header */
+        // LOCK (unlocked at scope exit)
+        uGuard dealloc_guard(m_lock);
+        m_free(pv);
+
+        U_DEBUG_DEALLOCATE(m_freeBytesRemaining, m_memoryLowWatermark);
+    }
+
+#ifdef UHEAP_DEBUG_CHECKS
+    template <typename Config>
+    bool basic_uheap<Config>::m_checkBlockSize(void *pv, size_t size)
+    {
+        if (pv == nullptr) { return true; }
+        if (!isOwned(pv)) { return false; }
+        /* The block is at least as big as the request and at most by an unsplit
+         remainder bigger */
+        const uBlockLink *p_link =
+            reinterpret_cast<uBlockLink *>(reinterpret_cast<uint8_t *>(pv) - HeapStructSize);
+        size_t block_size = p_link->headerSize();
+        size_t wanted_size = allignBlock(size + HeapStructSize);
+        if (wanted_size < MINIMUM_BLOCK_SIZE) { wanted_size = MINIMUM_BLOCK_SIZE; }
+        return (block_size >= wanted_size) && (block_size <= (wanted_size + MINIMUM_BLOCK_SIZE));
+    }
+#endif
+
+    template <typename Config>
+    void *basic_uheap<Config>::reallocate(void *pv, size_t new_size)
+    {
+        if (pv == nullptr) { return allocate(new_size); }
+        if (new_size == 0)
+        {
+            deallocate(pv);
+            return nullptr;
+        }
+#ifdef UHEAP_MMAP_THRESHOLD
+        uBlockLink *p_mapped = m_mappedBlock(pv);
+        if ((p_mapped != nullptr) && (new_size >= UHEAP_MMAP_THRESHOLD))
+        {
+            void *temp = m_remapBlock(p_mapped, new_size, true);
+            if (temp != nullptr)
+            {
+                U_TRACE(reallocate, temp, new_size, pv);
+                return temp;
+            }
+        }
+        if ((p_mapped != nullptr) || (new_size >= UHEAP_MMAP_THRESHOLD))
+        {
+            /* The block moves between the heap and a mapping */
+            size_t old_size;
+            if (p_mapped != nullptr)
+            {
+                old_size = p_mapped->size() - HeapStructSize;
+            } else
+            {
+                // LOCK (unlocked at scope exit)
+                uGuard size_guard(m_lock);
+                uBlockLink *p_link = m_allocatedBlock(pv);
+                if (p_link == nullptr)
+                {
+                    heapError();
+                    return nullptr;
+                }
+                old_size = p_link->size() - HeapStructSize;
+            }
+            void *temp = allocate(new_size);
+            if (temp != nullptr)
+            {
+                memcpy(temp, pv, (old_size < new_size) ? old_size : new_size);
+                deallocate(pv);
+            }
+            return temp;
+        }
+#endif
+        // LOCK (unlocked at scope exit)
+        uGuard realloc_guard(m_lock);
+        uBlockLink *p_link = m_allocatedBlock(pv);
+        if (p_link == nullptr)
+        {
+            heapError();
+            return nullptr;
+        }
+        if (m_resize(p_link, new_size))
+        {
+            U_TRACE(reallocate, pv, new_size, pv);
+            return pv;
+        }
+
+        /* Move the block, only the old payload is valid */
+        size_t old_size = p_link->size() - HeapStructSize;
+        void *temp = m_malloc(new_size);
+        if (temp != nullptr)
+        {
+            memcpy(temp, pv, (old_size < new_size) ? old_size : new_size);
+            m_free(pv);
+        }
+        /* The old block is free already, so it is traced under the lock */
+        U_TRACE(reallocate, temp, new_size, pv);
+        U_DEBUG_ALLOCATE(new_size, m_freeBytesRemaining, m_memoryLowWatermark);
+        return temp;
+    }
+
+    template <typename Config>
+    size_t basic_uheap<Config>::allocate_batch(size_t new_size, size_t count, void **out)
+    {
+        if ((new_size == 0) || (count == 0) || (out == nullptr)) { return 0; }
+        /* Same guard as in m_malloc, the rounding below would wrap around for huge sizes */
+        if (new_size > m_availableBytes()) { return 0; }
+        size_t block_size = allignBlock(new_size + HeapStructSize);
+        if (block_size < MINIMUM_BLOCK_SIZE) { block_size = MINIMUM_BLOCK_SIZE; }
+
+        size_t allocated = 0;
+        {
+            // LOCK (unlocked at scope exit)
+            uGuard batch_guard(m_lock);
+            m_drainDeferred();
+            while (allocated < count)
+            {
+                /* One free block for the whole rest of the batch, otherwise the biggest one */
+                const size_t rest = count - allocated;
+                uBlockLink *p_block =
+                    (rest <= m_freeBytesRemaining / block_size) ? m_findFreeBlock(rest * block_size) : nullptr;
+                if ((p_block == nullptr) && (m_flBitmap != 0))
+                {
+                    size_t fl = (sizeof(unsigned long) * BITS_PER_BYTE - 1) - __builtin_clzl(m_flBitmap);
+                    size_t sl = (sizeof(unsigned int) * BITS_PER_BYTE - 1) - __builtin_clz(m_slBitmap[fl]);
+                    p_block = m_freeLists[fl][sl];
+                    if (p_block->size() < block_size) { p_block = nullptr; }
+                }
+                if (p_block == nullptr)
+                {
+                    /* The grown heap ends with a block for the rest of the batch */
+                    if (m_grow((rest <= m_availableBytes() / block_size) ? rest * block_size : block_size))
+                    {
+                        continue;
+                    }
+                    heapFull();
+                    break;
+                }
+                m_unlinkFreeBlock(p_block);
+                allocated += m_carveBlock(p_block, block_size, rest, out + allocated);
+            }
+            U_DEBUG_ALLOCATE(new_size * allocated, m_freeBytesRemaining, m_memoryLowWatermark);
+        }
+        for (size_t i = 0; i < allocated; ++i)
+        {
+            U_TRACE(allocate, out[i], new_size, nullptr);
+        }
+        return allocated;
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::deallocate_batch(void **ptrs, size_t count)
+    {
+        if ((ptrs == nullptr) || (count == 0)) { return; }
+        std::sort(ptrs, ptrs + count, std::less<void *>());
+        for (size_t i = 0; i < count; ++i)
+        {
+            U_TRACE(deallocate, ptrs[i], 0, nullptr);
+#ifdef UHEAP_MMAP_THRESHOLD
+            if (m_unmapBlock(ptrs[i])) { ptrs[i] = nullptr; }
+#endif
+        }
+
+        // LOCK (unlocked at scope exit)
+        uGuard batch_guard(m_lock);
+        size_t i = 0;
+        while (i < count)
+        {
+            void *pv = ptrs[i++];
+            uBlockLink *p_run = m_allocatedBlock(pv);
+            if (p_run == nullptr)
+            {
+                /* Not a heap block or freed already, e.g. listed twice in the batch */
+                if (pv != nullptr) { heapError(); }
+                continue;
+            }
+            U_STATS_DEALLOCATION();
+
+            /* Join the following blocks of the batch if they are physically adjacent. The
+             headers of joined blocks stay inside the run, so they are marked free. */
+            size_t run_size = p_run->size();
+            while ((i < count) && (m_allocatedBlock(ptrs[i]) == p_run->next()))
+            {
+                U_STATS_DEALLOCATION();
+                p_run->next()->blockSize &= ~blockAllocatedBit;
+                run_size += p_run->next()->size();
+                p_run->blockSize = run_size | (p_run->blockSize & blockFlagsMask);
+                ++i;
+            }
+            p_run->blockSize &= ~blockAllocatedBit;
+            m_freeBytesRemaining += run_size;
+            U_VM_DIRTY(run_size);
+            m_insertFreeBlock(p_run);
+        }
+        U_DEBUG_DEALLOCATE(m_freeBytesRemaining, m_memoryLowWatermark);
+    }
+
+    template <typename Config>
+    bool basic_uheap<Config>::try_expand(void *pv, size_t new_size)
+    {
+        if (new_size == 0) { return false; }
+#ifdef UHEAP_MMAP_THRESHOLD
+        /* A mapped block stays mapped, so it can't shrink below the threshold */
+        uBlockLink *p_mapped = m_mappedBlock(pv);
+        if (p_mapped != nullptr)
+        {
+            return (new_size >= UHEAP_MMAP_THRESHOLD) && (m_remapBlock(p_mapped, new_size, false) != nullptr);
+        }
+#endif
+        // LOCK (unlocked at scope exit)
+        uGuard expand_guard(m_lock);
+        uBlockLink *p_link = m_allocatedBlock(pv);
+        return (p_link != nullptr) && m_resize(p_link, new_size);
+    }
+
+    template <typename Config>
+    size_t basic_uheap<Config>::usable_size(void *pv)
+    {
+        if (pv == nullptr) { return 0; }
+#ifdef UHEAP_MMAP_THRESHOLD
+        uBlockLink *p_mapped = m_mappedBlock(pv);
+        if (p_mapped != nullptr) { return p_mapped->size() - HeapStructSize; }
+#endif
+        /* Read without the lock like in the thread cache, neighbours change only the
+         blockPrevFreeBit of the header and do it with atomic stores */
+        uBlockLink *p_link = m_allocatedBlock(pv);
+        if (p_link == nullptr)
+        {
+            heapError();
+            return 0;
+        }
+        return p_link->headerSize() - HeapStructSize;
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::fork_prepare()
+    {
+        m_lock.lock();
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::fork_release()
+    {
+        m_lock.unlock();
+    }
+
+    template <typename Config>
+    void *basic_uheap<Config>::allocate_aligned(size_t new_size, size_t alignment)
+    {
+        /* Only power of two alignments are supported */
+        if ((alignment & (alignment - 1)) != 0) { return nullptr; }
+        if (alignment <= BYTE_ALIGNMENT) { return allocate(new_size); }
+
+        void *temp;
+        {
+            // LOCK (unlocked at scope exit)
+            uGuard alloc_guard(m_lock);
+            temp = m_mallocAligned(new_size, alignment);
+
+            U_DEBUG_ALLOCATE(new_size, m_freeBytesRemaining, m_memoryLowWatermark);
+        }
+        U_TRACE(allocate, temp, new_size, nullptr);
+        return temp;
+    }
+
+    template <typename Config>
+    void basic_uheap<Config>::heapError() { Config::errorHook(); }
+
+    template <typename Config>
+    void basic_uheap<Config>::heapFull()
+    {
+        if constexpr (Config::stats) { ++m_counters.failedAllocations; }
+        errno = ENOMEM;
+        Config::fullHook();
+    }
+
+} /* namespace ufw */
+
+#undef U_DEBUG_DEALLOCATE
+#undef U_DEBUG_ALLOCATE
+#undef U_STATS_ALLOCATION
+#undef U_STATS_DEALLOCATION
+#undef U_STATS_SEARCH
+#undef U_STATS_INSERT
+#undef U_VM_DIRTY
+#undef U_TRACE
+#undef userheapASSERT
+#undef UHEAP_SECTION_INT
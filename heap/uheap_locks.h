@@ -0,0 +1,232 @@
+/**
+ * @file uheap_locks.h
+ * @author Dmitry Donskikh (deedonskihdev@gmail.com)
+ * @brief "BasicLockable" locks for uHeap, selected with UHEAP_LOCK_TYPE
+ * @version 0.1
+ * @date 2021-09-20
+ *
+ * Copyright (c) 2018-2021 Dmitriy Donskikh
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#ifdef __linux__
+    #include <linux/futex.h>
+    #include <sched.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+namespace ufw
+{
+    /**
+     * @fn void uCpuRelax()
+     * @brief spin-wait hint for the CPU (pause/yield instruction)
+     */
+    inline __attribute__((always_inline)) void uCpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield" ::: "memory");
+#else
+        __asm__ __volatile__("" ::: "memory");
+#endif
+    }
+
+    /**
+     * @fn void uCpuYield()
+     * @brief gives the CPU away when spinning takes too long. Spinlocks can't make
+     * progress while the lock owner is preempted, so on hosted systems the waiter
+     * yields to the scheduler.
+     */
+    inline void uCpuYield()
+    {
+#ifdef __linux__
+        sched_yield();
+#else
+        uCpuRelax();
+#endif
+    }
+
+    /**
+     * @class uGuard<> - just a lock guard as in your stl
+     * @tparam Lockable - the type of the lock. The type must meet the BasicLockable
+     * requirements
+     */
+    template <typename Lockable>
+    class uGuard
+    {
+       private:
+        Lockable& m_lock_;
+        uGuard(uGuard const&) = delete;
+        uGuard& operator=(uGuard const&) = delete;
+
+       public:
+        __attribute__((__visibility__("hidden"), __always_inline__))
+        explicit uGuard(Lockable& lock) : m_lock_(lock) { m_lock_.lock(); }
+        __attribute__((__visibility__("hidden"), __always_inline__))
+        ~uGuard() { m_lock_.unlock(); }
+    };
+
+    /**
+     * @class uNullLock - no-op lock for objects used by a single thread
+     */
+    struct uNullLock
+    {
+        void lock() noexcept {}
+        bool try_lock() noexcept { return true; }
+        void unlock() noexcept {}
+    };
+
+    /**
+     * @class uSpinLock - test-and-test-and-set spinlock with exponential backoff.
+     * Waiters spin on a plain load, so the cache line is not bounced while the lock
+     * is held.
+     */
+    class uSpinLock
+    {
+       private:
+        std::atomic<bool> m_locked{false};
+
+       public:
+        /* Maximal number of pause instructions between two attempts, then the waiter
+         yields */
+        static constexpr uint32_t MAX_BACKOFF = 64;
+
+        void lock() noexcept
+        {
+            uint32_t backoff = 1;
+            while (m_locked.exchange(true, std::memory_order_acquire))
+            {
+                do
+                {
+                    if (backoff < MAX_BACKOFF)
+                    {
+                        for (uint32_t i = 0; i < backoff; ++i) uCpuRelax();
+                        backoff <<= 1;
+                    } else
+                    {
+                        uCpuYield();
+                    }
+                } while (m_locked.load(std::memory_order_relaxed));
+            }
+        }
+        bool try_lock() noexcept
+        {
+            return !m_locked.load(std::memory_order_relaxed) &&
+                   !m_locked.exchange(true, std::memory_order_acquire);
+        }
+        void unlock() noexcept { m_locked.store(false, std::memory_order_release); }
+    };
+
+    /**
+     * @class uTicketLock - FIFO fair spinlock. Waiters back off proportionally to
+     * their distance from the ticket being served and yield the CPU if the queue
+     * doesn't move for a long time. Every handoff waits for the next waiter to be
+     * scheduled, so prefer uFutexLock when threads outnumber cores.
+     */
+    class uTicketLock
+    {
+       private:
+        std::atomic<uint32_t> m_next{0};
+        std::atomic<uint32_t> m_serving{0};
+
+       public:
+        /* Pause instructions per waiter ahead in the queue */
+        static constexpr uint32_t BACKOFF_UNIT = 16;
+
+        /* Number of polls of the same ticket before yielding */
+        static constexpr uint32_t YIELD_THRESHOLD = 64;
+
+        void lock() noexcept
+        {
+            const uint32_t ticket = m_next.fetch_add(1, std::memory_order_relaxed);
+            uint32_t last_serving = m_serving.load(std::memory_order_relaxed);
+            uint32_t polls = 0;
+            for (;;)
+            {
+                const uint32_t serving = m_serving.load(std::memory_order_acquire);
+                if (serving == ticket) { return; }
+                if (serving != last_serving)
+                {
+                    last_serving = serving;
+                    polls = 0;
+                }
+                if (++polls < YIELD_THRESHOLD)
+                {
+                    for (uint32_t i = (ticket - serving) * BACKOFF_UNIT; i != 0; --i) uCpuRelax();
+                } else
+                {
+                    uCpuYield();
+                }
+            }
+        }
+        bool try_lock() noexcept
+        {
+            uint32_t serving = m_serving.load(std::memory_order_relaxed);
+            return m_next.compare_exchange_strong(serving, serving + 1, std::memory_order_acquire,
+                                                  std::memory_order_relaxed);
+        }
+        void unlock() noexcept
+        {
+            m_serving.store(m_serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+    };
+
+#ifdef __linux__
+    /**
+     * @class uFutexLock - adaptive mutex: spins for a short time and then parks the
+     * thread in the kernel with futex(2). State: 0 - unlocked, 1 - locked,
+     * 2 - locked and there may be sleeping waiters.
+     */
+    class uFutexLock
+    {
+       private:
+        std::atomic<uint32_t> m_state{0};
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32-bit");
+
+        void m_wait() noexcept
+        {
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_state), FUTEX_WAIT_PRIVATE, 2, nullptr,
+                    nullptr, 0);
+        }
+        void m_wake() noexcept
+        {
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_state), FUTEX_WAKE_PRIVATE, 1, nullptr,
+                    nullptr, 0);
+        }
+
+       public:
+        /* Number of attempts before the thread goes to sleep */
+        static constexpr uint32_t SPIN_COUNT = 100;
+
+        void lock() noexcept
+        {
+            for (uint32_t i = 0; i < SPIN_COUNT; ++i)
+            {
+                if (try_lock()) { return; }
+                uCpuRelax();
+            }
+            while (m_state.exchange(2, std::memory_order_acquire) != 0) { m_wait(); }
+        }
+        bool try_lock() noexcept
+        {
+            uint32_t expected = 0;
+            return (m_state.load(std::memory_order_relaxed) == 0) &&
+                   m_state.compare_exchange_strong(expected, 1, std::memory_order_acquire,
+                                                   std::memory_order_relaxed);
+        }
+        void unlock() noexcept
+        {
+            if (m_state.exchange(0, std::memory_order_release) == 2) { m_wake(); }
+        }
+    };
+#endif /* __linux__ */
+
+} /* namespace ufw */
@@ -13,6 +13,7 @@
 #include <./heap/uheap.h>
 
 #include <cstddef>
+#include <new>
 
 #if (UHEAP_OVERRIDES_NEW == 1)
 
@@ -30,4 +31,32 @@ void* operator new[](std::size_t size)
 
 void operator delete[](void* ptr) noexcept { ufw::uHeap::instance().deallocate(ptr); }
 
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return ufw::uHeap::instance().allocate_aligned(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept { ufw::uHeap::instance().deallocate(ptr); }
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return ufw::uHeap::instance().allocate_aligned(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept { ufw::uHeap::instance().deallocate(ptr); }
+
+void operator delete(void* ptr, std::size_t size) noexcept { ufw::uHeap::instance().deallocate(ptr, size); }
+
+void operator delete[](void* ptr, std::size_t size) noexcept { ufw::uHeap::instance().deallocate(ptr, size); }
+
+void operator delete(void* ptr, std::size_t size, std::align_val_t) noexcept
+{
+    ufw::uHeap::instance().deallocate(ptr, size);
+}
+
+void operator delete[](void* ptr, std::size_t size, std::align_val_t) noexcept
+{
+    ufw::uHeap::instance().deallocate(ptr, size);
+}
+
 #endif  // UHEAP_OVERRIDES_NEW
@@ -0,0 +1,168 @@
+/**
+ * @file uheap_placement.h
+ * @author Dmitry Donskikh (deedonskihdev@gmail.com)
+ * @brief Free block placement policies of uHeap, selected with UHEAP_PLACEMENT_POLICY
+ * @version 0.1
+ * @date 2021-11-02
+ *
+ * Copyright (c) 2018-2021 Dmitriy Donskikh
+ * All rights reserved.
+ *
+ * Free blocks are kept in segregated size class lists (TLSF), a policy decides which
+ * block of a list is taken and in which order the lists are kept:
+ *  - exactClass - the class of the request is searched before bigger classes. Blocks
+ *    of the own class may be smaller than the request, so the list is walked.
+ *  - ordered - freed blocks are inserted in before() order instead of at the list head.
+ *  - roving - the heap remembers the end of the last allocated block (rover).
+ *  - select(list, size, rover) - fitting block of a list or nullptr.
+ * Every block of a bigger class fits, there select() only chooses among them.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace ufw
+{
+    /**
+     * @fn Block* uFirstFitting(Block*, size_t)
+     * @brief first block of a free list not smaller than size
+     */
+    template <typename Block>
+    inline Block* uFirstFitting(Block* list, size_t size)
+    {
+        while ((list != nullptr) && (list->size() < size)) list = list->nextFreeBlock;
+        return list;
+    }
+
+    /**
+     * @struct uGoodFit - TLSF default. The request is rounded up to the next size class
+     * and the head of the first non-empty class is taken, so the search is O(1). Up to
+     * 1/16 of a block may be left unused.
+     */
+    struct uGoodFit
+    {
+        static constexpr const char* name = "good-fit";
+        static constexpr bool exactClass = false;
+        static constexpr bool ordered = false;
+        static constexpr bool roving = false;
+
+        template <typename Block>
+        static bool before(const Block*, const Block*)
+        {
+            return false;
+        }
+        template <typename Block>
+        static Block* select(Block* list, size_t size, const void*)
+        {
+            return (list->size() >= size) ? list : nullptr;
+        }
+    };
+
+    /**
+     * @struct uFirstFit - the first fitting block of the own class (most recently freed
+     * first), then the head of a bigger class. Searches are O(class list length).
+     */
+    struct uFirstFit
+    {
+        static constexpr const char* name = "first-fit";
+        static constexpr bool exactClass = true;
+        static constexpr bool ordered = false;
+        static constexpr bool roving = false;
+
+        template <typename Block>
+        static bool before(const Block*, const Block*)
+        {
+            return false;
+        }
+        template <typename Block>
+        static Block* select(Block* list, size_t size, const void*)
+        {
+            return uFirstFitting(list, size);
+        }
+    };
+
+    /**
+     * @struct uNextFit - the fitting block at the lowest address after the end of the
+     * previous allocation, wrapping around to the lowest fitting address. Consecutive
+     * allocations stay close to each other, free space ahead of the rover gets used
+     * before the freed blocks behind it.
+     */
+    struct uNextFit
+    {
+        static constexpr const char* name = "next-fit";
+        static constexpr bool exactClass = true;
+        static constexpr bool ordered = false;
+        static constexpr bool roving = true;
+
+        template <typename Block>
+        static bool before(const Block*, const Block*)
+        {
+            return false;
+        }
+        template <typename Block>
+        static Block* select(Block* list, size_t size, const void* rover)
+        {
+            Block* ahead = nullptr;
+            Block* lowest = nullptr;
+            for (; list != nullptr; list = list->nextFreeBlock)
+            {
+                if (list->size() < size) { continue; }
+                if ((static_cast<const void*>(list) >= rover) && ((ahead == nullptr) || (list < ahead)))
+                {
+                    ahead = list;
+                }
+                if ((lowest == nullptr) || (list < lowest)) { lowest = list; }
+            }
+            return (ahead != nullptr) ? ahead : lowest;
+        }
+    };
+
+    /**
+     * @struct uBestFit - size-ordered best fit. Class lists are kept sorted by size, so
+     * the first fitting block is the smallest one. Frees are O(class list length).
+     */
+    struct uBestFit
+    {
+        static constexpr const char* name = "best-fit";
+        static constexpr bool exactClass = true;
+        static constexpr bool ordered = true;
+        static constexpr bool roving = false;
+
+        template <typename Block>
+        static bool before(const Block* a, const Block* b)
+        {
+            return (a->size() < b->size()) || ((a->size() == b->size()) && (a < b));
+        }
+        template <typename Block>
+        static Block* select(Block* list, size_t size, const void*)
+        {
+            return uFirstFitting(list, size);
+        }
+    };
+
+    /**
+     * @struct uAddressOrderedFit - address-ordered first fit. Class lists are kept sorted
+     * by address, so the fitting block at the lowest address is taken and the end of the
+     * heap stays free as long as possible. Frees are O(class list length).
+     */
+    struct uAddressOrderedFit
+    {
+        static constexpr const char* name = "address-fit";
+        static constexpr bool exactClass = true;
+        static constexpr bool ordered = true;
+        static constexpr bool roving = false;
+
+        template <typename Block>
+        static bool before(const Block* a, const Block* b)
+        {
+            return a < b;
+        }
+        template <typename Block>
+        static Block* select(Block* list, size_t size, const void*)
+        {
+            return uFirstFitting(list, size);
+        }
+    };
+
+}  // namespace ufw
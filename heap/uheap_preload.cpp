@@ -0,0 +1,215 @@
+/**
+ * @file uheap_preload.cpp
+ * @author Dmitry Donskikh (deedonskihdev@gmail.com)
+ * @brief malloc family and new/delete operators of libuheap.so
+ * @version 0.1
+ * @date 2021-11-08
+ *
+ * Copyright (c) 2018-2021 Dmitriy Donskikh
+ * All rights reserved.
+ *
+ * Interposes the C library allocator of an unmodified binary:
+ *
+ *     LD_PRELOAD=/path/to/libuheap.so ./service
+ *
+ * Built by UHEAP_PRELOAD() from uheap.cmake with the global heap backed by virtual
+ * memory. The heap is constructed by the first call, which may come from the dynamic
+ * loader or libc before any constructor has run, so that path uses only mmap. The heap
+ * lock is taken around fork() to keep the heap of the child consistent.
+ */
+
+#include <heap/uheap.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <new>
+
+#ifndef UHEAP_VIRTUAL_MEMORY
+    #error "libuheap.so needs UHEAP_VIRTUAL_MEMORY, build it with UHEAP_PRELOAD()"
+#endif
+
+namespace
+{
+    using ufw::uHeap;
+
+    /* malloc(0) returns a unique pointer like glibc, some programs take nullptr for a failure */
+    inline void* preloadAllocate(size_t size)
+    {
+        void* temp = uHeap::instance().allocate((size != 0) ? size : 1);
+        if (temp == nullptr) { errno = ENOMEM; }
+        return temp;
+    }
+
+    inline void* preloadAllocateAligned(size_t alignment, size_t size)
+    {
+        if ((alignment == 0) || ((alignment & (alignment - 1)) != 0))
+        {
+            errno = EINVAL;
+            return nullptr;
+        }
+        void* temp = uHeap::instance().allocate_aligned((size != 0) ? size : 1, alignment);
+        if (temp == nullptr) { errno = ENOMEM; }
+        return temp;
+    }
+
+    /* operator new calls the new_handler until it gives up or the allocation succeeds */
+    void* preloadNew(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        if (size == 0) { size = 1; }
+        for (;;)
+        {
+            void* temp = uHeap::instance().allocate_aligned(size, alignment);
+            if (temp != nullptr) { return temp; }
+            std::new_handler handler = std::get_new_handler();
+            if (handler == nullptr) { throw std::bad_alloc(); }
+            handler();
+        }
+    }
+
+    void* preloadNewNothrow(size_t size, size_t alignment = alignof(std::max_align_t)) noexcept
+    {
+        try
+        {
+            return preloadNew(size, alignment);
+        } catch (...)
+        {
+            return nullptr;
+        }
+    }
+
+    void forkPrepare() { uHeap::instance().fork_prepare(); }
+
+    void forkRelease() { uHeap::instance().fork_release(); }
+
+    /* Handlers registered by later constructors run before forkPrepare and after forkRelease,
+     so they may allocate */
+    __attribute__((constructor)) void preloadInit() { pthread_atfork(forkPrepare, forkRelease, forkRelease); }
+
+}  // namespace
+
+extern "C"
+{
+    /* The default hooks print with printf, which may allocate while the heap lock is held */
+    void uHeapErrorHook()
+    {
+        static const char message[] = "uHeap: bad pointer\n";
+        if (write(STDERR_FILENO, message, sizeof(message) - 1) < 0) { return; }
+    }
+
+    /* A failed allocation is reported to the caller with ENOMEM */
+    void uHeapFullHook() {}
+
+    void* malloc(size_t size) { return preloadAllocate(size); }
+
+    void free(void* ptr) { uHeap::instance().deallocate(ptr); }
+
+    void* calloc(size_t count, size_t size)
+    {
+        if ((count == 0) || (size == 0)) { return preloadAllocate(0); }
+        void* temp = uHeap::instance().allocate_zeroed(count, size);
+        if (temp == nullptr) { errno = ENOMEM; }
+        return temp;
+    }
+
+    void* realloc(void* ptr, size_t size)
+    {
+        if (ptr == nullptr) { return preloadAllocate(size); }
+        void* temp = uHeap::instance().reallocate(ptr, size);
+        if ((temp == nullptr) && (size != 0)) { errno = ENOMEM; }
+        return temp;
+    }
+
+    void* memalign(size_t alignment, size_t size) { return preloadAllocateAligned(alignment, size); }
+
+    void* aligned_alloc(size_t alignment, size_t size) { return preloadAllocateAligned(alignment, size); }
+
+    int posix_memalign(void** memptr, size_t alignment, size_t size)
+    {
+        if ((alignment == 0) || ((alignment % sizeof(void*)) != 0) || ((alignment & (alignment - 1)) != 0))
+        {
+            return EINVAL;
+        }
+        void* temp = uHeap::instance().allocate_aligned((size != 0) ? size : 1, alignment);
+        if (temp == nullptr) { return ENOMEM; }
+        *memptr = temp;
+        return 0;
+    }
+
+    void* valloc(size_t size) { return preloadAllocateAligned(sysconf(_SC_PAGESIZE), size); }
+
+    /* Obsolete, but libc would serve it from its own heap and the block would reach free() */
+    void* pvalloc(size_t size)
+    {
+        const size_t page = sysconf(_SC_PAGESIZE);
+        return preloadAllocateAligned(page, (size + page - 1) & ~(page - 1));
+    }
+
+    size_t malloc_usable_size(void* ptr) { return uHeap::instance().usable_size(ptr); }
+}
+
+void* operator new(std::size_t size) { return preloadNew(size); }
+
+void* operator new[](std::size_t size) { return preloadNew(size); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return preloadNewNothrow(size); }
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return preloadNewNothrow(size); }
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return preloadNew(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return preloadNew(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return preloadNewNothrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return preloadNewNothrow(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* ptr) noexcept { uHeap::instance().deallocate(ptr); }
+
+void operator delete[](void* ptr) noexcept { uHeap::instance().deallocate(ptr); }
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { uHeap::instance().deallocate(ptr); }
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { uHeap::instance().deallocate(ptr); }
+
+void operator delete(void* ptr, std::align_val_t) noexcept { uHeap::instance().deallocate(ptr); }
+
+void operator delete[](void* ptr, std::align_val_t) noexcept { uHeap::instance().deallocate(ptr); }
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    uHeap::instance().deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    uHeap::instance().deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::size_t size) noexcept { uHeap::instance().deallocate(ptr, size); }
+
+void operator delete[](void* ptr, std::size_t size) noexcept { uHeap::instance().deallocate(ptr, size); }
+
+void operator delete(void* ptr, std::size_t size, std::align_val_t) noexcept
+{
+    uHeap::instance().deallocate(ptr, size);
+}
+
+void operator delete[](void* ptr, std::size_t size, std::align_val_t) noexcept
+{
+    uHeap::instance().deallocate(ptr, size);
+}
@@ -0,0 +1,231 @@
+/**
+ * @file uheap_resource.h
+ * @author Dmitry Donskikh (deedonskihdev@gmail.com)
+ * @brief std::pmr::memory_resource adapters for uHeap, pools and arenas
+ * @version 0.1
+ * @date 2021-10-07
+ *
+ * Copyright (c) 2018-2021 Dmitriy Donskikh
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include "uarena.h"
+#include "uheap.h"
+#include "upool.h"
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <tuple>
+#include <utility>
+
+namespace ufw
+{
+    /**
+     * @fn void* uResourceResult(void*)
+     * @brief memory_resource must not return nullptr, so failures become std::bad_alloc
+     * when exceptions are enabled
+     */
+    inline void* uResourceResult(void* pv)
+    {
+#if defined(__cpp_exceptions)
+        if (pv == nullptr) { throw std::bad_alloc(); }
+#endif
+        return pv;
+    }
+
+    /**
+     * @fn const Resource* uResourceCast(const Resource&, const std::pmr::memory_resource&)
+     * @brief Resource of the given type or nullptr. Without RTTI only the same object is
+     * recognized.
+     */
+    template <typename Resource>
+    inline const Resource* uResourceCast(const Resource& self, const std::pmr::memory_resource& other) noexcept
+    {
+#if defined(__cpp_rtti) || defined(__GXX_RTTI)
+        (void)self;
+        return dynamic_cast<const Resource*>(&other);
+#else
+        return (&other == &self) ? &self : nullptr;
+#endif
+    }
+
+    /**
+     * @class uHeapResource
+     * @brief memory_resource backed by a uHeap instance. Resources of the same heap are
+     * equal and may free each other's memory.
+     */
+    class uHeapResource : public std::pmr::memory_resource
+    {
+       public:
+        explicit uHeapResource(uHeap& heap = uHeap::instance()) noexcept : m_heap(heap) {}
+
+        uHeap& heap() const noexcept { return m_heap; }
+
+       protected:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            /* A zero-byte request is valid, uHeap returns nullptr for it */
+            return uResourceResult(m_heap.allocate_aligned((bytes != 0) ? bytes : 1, alignment));
+        }
+        void do_deallocate(void* p, size_t bytes, size_t) override { m_heap.deallocate(p, bytes); }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            const auto* resource = uResourceCast(*this, other);
+            return (resource != nullptr) && (&resource->m_heap == &m_heap);
+        }
+
+       private:
+        uHeap& m_heap;
+    };
+
+    /**
+     * @class uPoolResource
+     * @brief memory_resource with a uSlab per power-of-two size class up to
+     * UHEAP_POOL_RESOURCE_MAX_SIZE bytes, bigger or over-aligned blocks come from the heap.
+     * Only the same pool can free its memory.
+     * @tparam Lockable - "BasicLockable" lock of the slabs
+     */
+    template <typename Lockable>
+    class uPoolResource : public std::pmr::memory_resource
+    {
+       private:
+        static constexpr size_t MIN_CLASS_LOG2 = log2ceil(alignof(std::max_align_t));
+        static constexpr size_t CLASS_COUNT = log2ceil(UHEAP_POOL_RESOURCE_MAX_SIZE) - MIN_CLASS_LOG2 + 1;
+
+        template <size_t Class>
+        using uClassSlab = uSlab<(size_t)1 << (MIN_CLASS_LOG2 + Class), alignof(std::max_align_t), Lockable>;
+
+        template <typename Sequence>
+        struct uSlabs;
+        template <size_t... Classes>
+        struct uSlabs<std::index_sequence<Classes...>>
+        {
+            using type = std::tuple<uClassSlab<Classes>...>;
+        };
+
+       public:
+        explicit uPoolResource(uHeap& heap = uHeap::instance())
+            : m_heap(heap), m_slabs(m_makeSlabs(heap, std::make_index_sequence<CLASS_COUNT>()))
+        {
+        }
+
+        uHeap& heap() const noexcept { return m_heap; }
+
+        /**
+         * @fn void release()
+         * @brief Return all chunks of the slabs to the heap. All pooled memory is freed.
+         */
+        void release()
+        {
+            std::apply([](auto&... slab) { (slab.release(), ...); }, m_slabs);
+        }
+
+       protected:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            const size_t size_class = m_sizeClass(bytes, alignment);
+            if (size_class >= CLASS_COUNT)
+            {
+                /* Zero bytes still need a block, see uHeapResource::do_allocate */
+                return uResourceResult(m_heap.allocate_aligned((bytes != 0) ? bytes : 1, alignment));
+            }
+            return uResourceResult(m_allocate(size_class, std::make_index_sequence<CLASS_COUNT>()));
+        }
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override
+        {
+            const size_t size_class = m_sizeClass(bytes, alignment);
+            if (size_class >= CLASS_COUNT)
+            {
+                m_heap.deallocate(p, bytes);
+                return;
+            }
+            m_deallocate(size_class, p, std::make_index_sequence<CLASS_COUNT>());
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+       private:
+        uHeap& m_heap;
+        typename uSlabs<std::make_index_sequence<CLASS_COUNT>>::type m_slabs;
+
+        template <size_t... Classes>
+        static auto m_makeSlabs(uHeap& heap, std::index_sequence<Classes...>)
+        {
+            return typename uSlabs<std::index_sequence<Classes...>>::type(((void)Classes, heap)...);
+        }
+
+        /* CLASS_COUNT for blocks going directly to the heap */
+        static size_t m_sizeClass(size_t bytes, size_t alignment)
+        {
+            if ((alignment > alignof(std::max_align_t)) || (bytes > UHEAP_POOL_RESOURCE_MAX_SIZE)) { return CLASS_COUNT; }
+            const size_t bytes_log2 = log2ceil(bytes);
+            return (bytes_log2 > MIN_CLASS_LOG2) ? (bytes_log2 - MIN_CLASS_LOG2) : 0;
+        }
+
+        template <size_t... Classes>
+        void* m_allocate(size_t size_class, std::index_sequence<Classes...>)
+        {
+            void* pv = nullptr;
+            (void)((size_class == Classes ? (pv = std::get<Classes>(m_slabs).allocate(), true) : false) || ...);
+            return pv;
+        }
+
+        template <size_t... Classes>
+        void m_deallocate(size_t size_class, void* p, std::index_sequence<Classes...>)
+        {
+            (void)((size_class == Classes ? (std::get<Classes>(m_slabs).deallocate(p), true) : false) || ...);
+        }
+    };
+
+    /**
+     * @brief Pool resource safe to share between threads
+     */
+    using uSynchronizedPoolResource = uPoolResource<UHEAP_LOCK_TYPE>;
+    /**
+     * @brief Pool resource for single-threaded use
+     */
+    using uUnsynchronizedPoolResource = uPoolResource<uNullLock>;
+
+    /**
+     * @class uArenaResource
+     * @brief Monotonic memory_resource over uArena, deallocation is a no-op
+     * @tparam Lockable - lock type of the arena
+     */
+    template <typename Lockable = uNullLock>
+    class uArenaResource : public std::pmr::memory_resource
+    {
+       public:
+        explicit uArenaResource(uArena<Lockable>& arena) noexcept : m_arena(arena) {}
+
+        uArena<Lockable>& arena() const noexcept { return m_arena; }
+
+       protected:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            return uResourceResult(m_arena.allocate(bytes, alignment));
+        }
+        void do_deallocate(void*, size_t, size_t) override {}
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            const auto* resource = uResourceCast(*this, other);
+            return (resource != nullptr) && (&resource->m_arena == &m_arena);
+        }
+
+       private:
+        uArena<Lockable>& m_arena;
+    };
+
+    /**
+     * @fn uHeapResource* uheap_resource()
+     * @brief memory_resource of the global heap
+     */
+    inline uHeapResource* uheap_resource() noexcept
+    {
+        static uHeapResource s_resource;
+        return &s_resource;
+    }
+
+}  // namespace ufw
@@ -0,0 +1,138 @@
+/**
+ * @file uheap_trace.cpp
+ * @author Dmitry Donskikh (deedonskihdev@gmail.com)
+ * @brief Allocation events tracing (enabled with UHEAP_TRACE)
+ * @version 0.1
+ * @date 2021-10-14
+ *
+ * Copyright (c) 2018-2021 Dmitriy Donskikh
+ * All rights reserved.
+ *
+ */
+
+#include <heap/uheap_trace.h>
+
+#ifdef UHEAP_TRACE
+
+    #include <atomic>
+
+    #ifndef UHEAP_TRACE_CLOCK
+        #include <chrono>
+        #define UHEAP_TRACE_CLOCK()                                                   \
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>( \
+                                      std::chrono::steady_clock::now().time_since_epoch()) \
+                                      .count())
+    #endif
+
+namespace ufw
+{
+    namespace
+    {
+        /* Single producer (the owner thread), single consumer (drain) ring */
+        struct uTraceRing
+        {
+            std::atomic<bool> owned{false};
+            std::atomic<size_t> head{0};
+            std::atomic<size_t> tail{0};
+            uTraceEvent events[UHEAP_TRACE_BUFFER_SIZE];
+        };
+
+        uTraceRing s_rings[UHEAP_TRACE_THREADS];
+        std::atomic<size_t> s_dropped{0};
+        std::atomic<uint16_t> s_threads{0};
+        std::atomic<bool> s_draining{false};
+
+        /* Ring of the calling thread, given back at thread exit. Events left in it are
+         drained later. */
+        struct uTraceSlot
+        {
+            uTraceRing* ring = nullptr;
+            uint16_t thread = 0;
+
+            ~uTraceSlot()
+            {
+                if (ring != nullptr) { ring->owned.store(false, std::memory_order_release); }
+            }
+
+            bool claim()
+            {
+                for (auto& candidate : s_rings)
+                {
+                    bool expected = false;
+                    if (!candidate.owned.load(std::memory_order_relaxed) &&
+                        candidate.owned.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                    {
+                        ring = &candidate;
+                        thread = s_threads.fetch_add(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                }
+                return false;
+            }
+        };
+
+        thread_local uTraceSlot t_slot;
+    }  // namespace
+
+    void uTrace::record(uTraceOp op, const void* pointer, size_t size, const void* previous)
+    {
+        uTraceSlot& slot = t_slot;
+        if ((slot.ring == nullptr) && !slot.claim())
+        {
+            s_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        uTraceRing& ring = *slot.ring;
+        const size_t head = ring.head.load(std::memory_order_relaxed);
+        if (head - ring.tail.load(std::memory_order_acquire) == UHEAP_TRACE_BUFFER_SIZE)
+        {
+            s_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        uTraceEvent& event = ring.events[head % UHEAP_TRACE_BUFFER_SIZE];
+        event.timestamp = UHEAP_TRACE_CLOCK();
+        event.pointer = reinterpret_cast<size_t>(pointer);
+        event.previous = reinterpret_cast<size_t>(previous);
+        event.size = (size < UINT32_MAX) ? static_cast<uint32_t>(size) : UINT32_MAX;
+        event.thread = slot.thread;
+        event.op = static_cast<uint8_t>(op);
+        event.reserved = 0;
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    void uTrace::header(uTraceWriter writer, void* context)
+    {
+        if (writer == nullptr) { return; }
+        uTraceHeader header{UHEAP_TRACE_MAGIC, UHEAP_TRACE_VERSION, sizeof(uTraceEvent)};
+        writer(&header, sizeof(header), context);
+    }
+
+    size_t uTrace::drain(uTraceWriter writer, void* context)
+    {
+        if ((writer == nullptr) || s_draining.exchange(true, std::memory_order_acquire)) { return 0; }
+        size_t written = 0;
+        for (auto& ring : s_rings)
+        {
+            size_t tail = ring.tail.load(std::memory_order_relaxed);
+            const size_t head = ring.head.load(std::memory_order_acquire);
+            while (tail != head)
+            {
+                /* Events up to the end of the buffer are contiguous */
+                const size_t index = tail % UHEAP_TRACE_BUFFER_SIZE;
+                size_t count = head - tail;
+                if (count > UHEAP_TRACE_BUFFER_SIZE - index) { count = UHEAP_TRACE_BUFFER_SIZE - index; }
+                writer(&ring.events[index], count * sizeof(uTraceEvent), context);
+                tail += count;
+                written += count;
+            }
+            ring.tail.store(tail, std::memory_order_release);
+        }
+        s_draining.store(false, std::memory_order_release);
+        return written;
+    }
+
+    size_t uTrace::dropped() { return s_dropped.load(std::memory_order_relaxed); }
+
+}  // namespace ufw
+
+#endif /* UHEAP_TRACE */
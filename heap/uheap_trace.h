@@ -0,0 +1,94 @@
+/**
+ * @file uheap_trace.h
+ * @author Dmitry Donskikh (deedonskihdev@gmail.com)
+ * @brief Allocation events tracing (enabled with UHEAP_TRACE)
+ * @version 0.1
+ * @date 2021-10-14
+ *
+ * Copyright (c) 2018-2021 Dmitriy Donskikh
+ * All rights reserved.
+ *
+ * Every thread records its heap calls into its own lock-free ring buffer, some thread
+ * drains the buffers with uTrace::drain() to a file or any other sink. A trace is a
+ * uTraceHeader followed by uTraceEvent records, events of different threads are not
+ * ordered in the stream and should be sorted by timestamp. All fields are in the byte
+ * order of the target.
+ */
+
+#pragma once
+
+#include "../uheap_opt.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ufw
+{
+    constexpr uint32_t UHEAP_TRACE_MAGIC = 0x52544855UL; /* "UHTR" */
+    constexpr uint16_t UHEAP_TRACE_VERSION = 1;
+
+    enum class uTraceOp : uint8_t
+    {
+        allocate = 1,
+        deallocate = 2,
+        reallocate = 3
+    };
+
+    struct uTraceHeader
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t eventSize;
+    };
+
+    struct uTraceEvent
+    {
+        /* UHEAP_TRACE_CLOCK() units */
+        uint64_t timestamp;
+        /* Allocated or freed block, result of a reallocation */
+        uint64_t pointer;
+        /* Reallocated block */
+        uint64_t previous;
+        /* Requested size */
+        uint32_t size;
+        /* Number of the thread in order of their first heap call */
+        uint16_t thread;
+        uint8_t op;
+        uint8_t reserved;
+    };
+
+    /**
+     * @class uTrace - per-thread ring buffers of heap events. Buffers are taken from a
+     * static pool of UHEAP_TRACE_THREADS, events of threads without a buffer and events
+     * recorded into a full buffer are dropped and counted.
+     */
+    class uTrace
+    {
+       public:
+        using uTraceWriter = void (*)(const void* data, size_t size, void* context);
+
+        /**
+         * @fn void record(uTraceOp, const void*, size_t, const void*)
+         * @brief Record an event of the calling thread, never blocks
+         */
+        static void record(uTraceOp op, const void* pointer, size_t size, const void* previous = nullptr);
+        /**
+         * @fn void header(uTraceWriter, void*)
+         * @brief Write the trace header, must be written once before the events
+         */
+        static void header(uTraceWriter writer, void* context);
+        /**
+         * @fn size_t drain(uTraceWriter, void*)
+         * @brief Write recorded events of all threads and free their buffers. Concurrent
+         * drains return at once.
+         * @return number of events written
+         */
+        static size_t drain(uTraceWriter writer, void* context);
+        /**
+         * @fn size_t dropped()
+         * @brief Number of events lost so far
+         */
+        static size_t dropped();
+    };
+
+}  // namespace ufw
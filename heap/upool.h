@@ -0,0 +1,256 @@
+/**
+ * @file upool.h
+ * @author Dmitry Donskikh (deedonskihdev@gmail.com)
+ * @brief Fixed-size object pools (slabs) on top of uHeap
+ * @version 0.1
+ * @date 2021-10-02
+ *
+ * Copyright (c) 2018-2021 Dmitriy Donskikh
+ * All rights reserved.
+ *
+ */
+
+#pragma once
+
+#include "../uheap_allocator.h"
+#include "uheap.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace ufw
+{
+    /**
+     * @class uSlab
+     * @brief Fixed-size objects allocator. Takes big chunks from uHeap and hands out
+     * objects from them without any per-object header. Freed objects are kept in an
+     * embedded free list, so both allocation and deallocation are O(1). Chunks are
+     * returned to the heap only when the slab is destroyed.
+     * @tparam ObjectSize - size of one object in bytes
+     * @tparam ObjectAlign - alignment of objects
+     * @tparam Lockable - "BasicLockable" lock (uNullLock for single-threaded use)
+     */
+    template <size_t ObjectSize, size_t ObjectAlign = alignof(std::max_align_t),
+              typename Lockable = UHEAP_LOCK_TYPE>
+    class uSlab
+    {
+       public:
+        static constexpr size_t SLOT_ALIGN = (ObjectAlign > alignof(void*)) ? ObjectAlign : alignof(void*);
+        static constexpr size_t SLOT_SIZE =
+            ((ObjectSize > sizeof(void*) ? ObjectSize : sizeof(void*)) + SLOT_ALIGN - 1) & ~(SLOT_ALIGN - 1);
+
+        static_assert((ObjectAlign & (ObjectAlign - 1)) == 0, "Alignment must be a power of two");
+
+        /**
+         * @brief uSlab - Constructor, no memory is taken until the first allocation
+         * @param heap - heap to take chunks from
+         * @param objects_per_chunk - number of objects in a chunk (0 for default)
+         */
+        explicit uSlab(uHeap& heap = uHeap::instance(), size_t objects_per_chunk = 0)
+            : m_heap(heap),
+              m_chunkObjects((objects_per_chunk != 0) ? objects_per_chunk : DEFAULT_CHUNK_OBJECTS)
+        {
+        }
+        ~uSlab() { release(); }
+
+        /**
+         * @fn void allocate*()
+         * @brief Allocate one object
+         * @return pointer to uninitialized object or nullptr if the heap is full
+         */
+        void* allocate()
+        {
+            // LOCK (unlocked at scope exit)
+            uGuard alloc_guard(m_lock);
+            if (m_freeList != nullptr)
+            {
+                uSlot* slot = m_freeList;
+                m_freeList = slot->next;
+                return slot;
+            }
+            /* Carve slots of the newest chunk lazily, so a new chunk isn't touched at once */
+            if ((m_bump == m_bumpEnd) && !m_grow()) { return nullptr; }
+            void* object = m_bump;
+            m_bump += SLOT_SIZE;
+            return object;
+        }
+
+        /**
+         * @fn void deallocate(void*)
+         * @brief Return an object allocated by this slab
+         * @param pv
+         */
+        void deallocate(void* pv)
+        {
+            if (pv == nullptr) { return; }
+            // LOCK (unlocked at scope exit)
+            uGuard dealloc_guard(m_lock);
+            uSlot* slot = static_cast<uSlot*>(pv);
+            slot->next = m_freeList;
+            m_freeList = slot;
+        }
+
+        /**
+         * @fn void release()
+         * @brief Return all chunks to the heap. All objects must be deallocated or
+         * abandoned before.
+         */
+        void release()
+        {
+            // LOCK (unlocked at scope exit)
+            uGuard release_guard(m_lock);
+            while (m_chunks != nullptr)
+            {
+                uChunk* chunk = m_chunks;
+                m_chunks = chunk->next;
+                m_heap.deallocate(chunk);
+            }
+            m_freeList = nullptr;
+            m_bump = m_bumpEnd = nullptr;
+            m_chunkCount = 0;
+        }
+
+        /**
+         * @brief chunks - number of chunks taken from the heap
+         */
+        size_t chunks() const { return m_chunkCount; }
+
+       private:
+        union uSlot
+        {
+            uSlot* next;
+            alignas(SLOT_ALIGN) uint8_t storage[SLOT_SIZE];
+        };
+        struct uChunk
+        {
+            uChunk* next;
+        };
+
+        static constexpr size_t CHUNK_HEADER_SIZE = (sizeof(uChunk) + SLOT_ALIGN - 1) & ~(SLOT_ALIGN - 1);
+        static constexpr size_t DEFAULT_CHUNK_OBJECTS =
+            ((UHEAP_POOL_CHUNK_SIZE - CHUNK_HEADER_SIZE) / SLOT_SIZE > 8)
+                ? (UHEAP_POOL_CHUNK_SIZE - CHUNK_HEADER_SIZE) / SLOT_SIZE
+                : 8;
+
+        uHeap& m_heap;
+        const size_t m_chunkObjects;
+        uSlot* m_freeList = nullptr;
+        uChunk* m_chunks = nullptr;
+        uint8_t* m_bump = nullptr;
+        uint8_t* m_bumpEnd = nullptr;
+        size_t m_chunkCount = 0;
+        Lockable m_lock{};
+
+        bool m_grow()
+        {
+            const size_t slots_size = m_chunkObjects * SLOT_SIZE;
+            auto* chunk = static_cast<uChunk*>(m_heap.allocate_aligned(CHUNK_HEADER_SIZE + slots_size, SLOT_ALIGN));
+            if (chunk == nullptr) { return false; }
+            chunk->next = m_chunks;
+            m_chunks = chunk;
+            ++m_chunkCount;
+            m_bump = reinterpret_cast<uint8_t*>(chunk) + CHUNK_HEADER_SIZE;
+            m_bumpEnd = m_bump + slots_size;
+            return true;
+        }
+
+        uSlab(const uSlab&) = delete;
+        uSlab& operator=(const uSlab&) = delete;
+    };
+
+    /**
+     * @class uPool
+     * @brief Typed pool of objects on top of uSlab
+     * @tparam T - object type
+     * @tparam Lockable - "BasicLockable" lock
+     */
+    template <typename T, typename Lockable = UHEAP_LOCK_TYPE>
+    class uPool : public uSlab<sizeof(T), alignof(T), Lockable>
+    {
+       public:
+        using uSlab<sizeof(T), alignof(T), Lockable>::uSlab;
+
+        /**
+         * @brief create - allocate and construct an object
+         * @return nullptr if there is no memory
+         */
+        template <typename... Args>
+        T* create(Args&&... args)
+        {
+            void* pv = this->allocate();
+            return (pv != nullptr) ? new (pv) T(std::forward<Args>(args)...) : nullptr;
+        }
+        /**
+         * @brief destroy - destruct and deallocate an object created by this pool
+         */
+        void destroy(T* object)
+        {
+            if (object == nullptr) { return; }
+            object->~T();
+            this->deallocate(object);
+        }
+    };
+
+    /**
+     * @fn uSlab uSharedSlab&()
+     * @brief Global slab of the global heap for objects of the given size. It is never
+     * destroyed, so containers with static lifetime may release their nodes at exit.
+     */
+    template <size_t ObjectSize, size_t ObjectAlign>
+    uSlab<ObjectSize, ObjectAlign>& uSharedSlab()
+    {
+        alignas(uSlab<ObjectSize, ObjectAlign>) static uint8_t s_storage[sizeof(uSlab<ObjectSize, ObjectAlign>)];
+        static uSlab<ObjectSize, ObjectAlign>* s_slab = new (s_storage) uSlab<ObjectSize, ObjectAlign>();
+        return *s_slab;
+    }
+
+}  // namespace ufw
+
+/**
+ * @brief stl-compatible allocator for node-based containers (list, map, set...).
+ * Single objects come from the shared slab of their size, arrays from uHeap.
+ * @tparam T
+ */
+template <class T>
+class uPoolAllocator
+{
+   public:
+    typedef T value_type;
+    uPoolAllocator() noexcept = default;
+
+    template <class U>
+    constexpr uPoolAllocator(const uPoolAllocator<U>&) noexcept
+    {
+    }
+
+    T* allocate(size_t n) noexcept
+    {
+        if (n == 1) { return static_cast<T*>(ufw::uSharedSlab<sizeof(T), alignof(T)>().allocate()); }
+        return uHeapAllocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, size_t n) noexcept
+    {
+        if (p == nullptr) { return; }
+        if (n == 1)
+        {
+            ufw::uSharedSlab<sizeof(T), alignof(T)>().deallocate(p);
+        } else
+        {
+            uHeapAllocator<T>().deallocate(p, n);
+        }
+    }
+};
+
+template <class T, class U>
+bool operator==(const uPoolAllocator<T>&, const uPoolAllocator<U>&)
+{
+    return true;
+}
+template <class T, class U>
+bool operator!=(const uPoolAllocator<T>&, const uPoolAllocator<U>&)
+{
+    return false;
+}
@@ -0,0 +1,231 @@
+/**
+ * @file uheap_analyze.cpp
+ * @author Dmitry Donskikh (deedonskihdev@gmail.com)
+ * @brief Host-side analyzer of heap maps written by uHeap::dump()
+ * @version 0.1
+ * @date 2021-10-12
+ *
+ * Copyright (c) 2018-2021 Dmitriy Donskikh
+ * All rights reserved.
+ *
+ * Usage: uheap_analyze DUMP [--width N] [--rows N] [--svg FILE]
+ * Prints the heap summary, fragmentation, distribution of free runs and allocated
+ * blocks by power of two and an ASCII map of the heap ('#' allocated, '.' free,
+ * '+' mixed). With --svg the map is also written as an SVG picture.
+ */
+
+#include <heap/uheap_dump.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Block
+    {
+        uint64_t offset;
+        uint64_t size;
+        bool allocated;
+    };
+
+    struct Dump
+    {
+        ufw::uHeapDumpHeader header;
+        std::vector<Block> blocks;
+    };
+
+    bool load(const char* path, Dump& dump)
+    {
+        FILE* f = fopen(path, "rb");
+        if (f == nullptr)
+        {
+            fprintf(stderr, "can't open %s\n", path);
+            return false;
+        }
+        bool ok = fread(&dump.header, sizeof(dump.header), 1, f) == 1;
+        if (!ok || (dump.header.magic != ufw::UHEAP_DUMP_MAGIC) || (dump.header.version == 0) ||
+            (dump.header.version > ufw::UHEAP_DUMP_VERSION) || (dump.header.granularity == 0))
+        {
+            fprintf(stderr, "%s is not a uHeap dump of version up to %u (or has another byte order)\n", path,
+                    ufw::UHEAP_DUMP_VERSION);
+            fclose(f);
+            return false;
+        }
+        /* Version 1 has no continued records */
+        const uint32_t continued = (dump.header.version >= 2) ? ufw::UHEAP_DUMP_CONTINUED : 0;
+        uint64_t offset = dump.header.firstBlock;
+        uint64_t units = 0;
+        uint32_t record = 0;
+        while ((ok = (fread(&record, sizeof(record), 1, f) == 1)) && (record != 0))
+        {
+            units += (record & ~continued) >> 1;
+            if ((record & continued) != 0) { continue; }
+            uint64_t size = units * dump.header.granularity;
+            dump.blocks.push_back({offset, size, (record & 1) != 0});
+            offset += size;
+            units = 0;
+        }
+        fclose(f);
+        if (!ok) { fprintf(stderr, "%s is truncated, %zu blocks read\n", path, dump.blocks.size()); }
+        return true;
+    }
+
+    unsigned log2floor(uint64_t value)
+    {
+        unsigned result = 0;
+        while (value >>= 1) ++result;
+        return result;
+    }
+
+    void histogram(const Dump& dump, bool allocated)
+    {
+        uint64_t counts[64] = {}, bytes[64] = {};
+        for (const Block& b : dump.blocks)
+        {
+            if (b.allocated != allocated) { continue; }
+            ++counts[log2floor(b.size)];
+            bytes[log2floor(b.size)] += b.size;
+        }
+        printf("\n%s blocks by size:\n%14s %10s %14s\n", allocated ? "Allocated" : "Free", "size >=", "count", "bytes");
+        for (unsigned i = 0; i < 64; ++i)
+        {
+            if (counts[i] != 0)
+            {
+                printf("%14llu %10llu %14llu\n", 1ULL << i, static_cast<unsigned long long>(counts[i]),
+                       static_cast<unsigned long long>(bytes[i]));
+            }
+        }
+    }
+
+    void summary(const Dump& dump)
+    {
+        uint64_t free_bytes = 0, free_blocks = 0, used_bytes = 0, used_blocks = 0, largest = 0;
+        for (const Block& b : dump.blocks)
+        {
+            if (b.allocated)
+            {
+                used_bytes += b.size;
+                ++used_blocks;
+            } else
+            {
+                free_bytes += b.size;
+                ++free_blocks;
+                largest = std::max(largest, b.size);
+            }
+        }
+        const auto& h = dump.header;
+        printf("Heap at 0x%llx, %llu bytes, first block at +%llu\n", static_cast<unsigned long long>(h.heapBase),
+               static_cast<unsigned long long>(h.heapSize), static_cast<unsigned long long>(h.firstBlock));
+        printf("Free bytes (heap counter): %llu, low watermark: %llu\n", static_cast<unsigned long long>(h.freeBytes),
+               static_cast<unsigned long long>(h.lowWatermark));
+        printf("Allocated: %llu blocks, %llu bytes\n", static_cast<unsigned long long>(used_blocks),
+               static_cast<unsigned long long>(used_bytes));
+        printf("Free: %llu blocks, %llu bytes, largest %llu\n", static_cast<unsigned long long>(free_blocks),
+               static_cast<unsigned long long>(free_bytes), static_cast<unsigned long long>(largest));
+        printf("Fragmentation (1 - largest/free): %.3f\n",
+               (free_bytes != 0) ? 1.0 - static_cast<double>(largest) / free_bytes : 0.0);
+    }
+
+    void asciiMap(const Dump& dump, unsigned width, unsigned rows)
+    {
+        const uint64_t cells = static_cast<uint64_t>(width) * rows;
+        const uint64_t cell_bytes = std::max<uint64_t>(1, (dump.header.heapSize + cells - 1) / cells);
+        std::vector<uint64_t> used(cells, 0), free(cells, 0);
+        for (const Block& b : dump.blocks)
+        {
+            /* Spread the block over the cells it covers */
+            uint64_t pos = b.offset, end = b.offset + b.size;
+            while (pos < end)
+            {
+                uint64_t cell = pos / cell_bytes;
+                if (cell >= cells) { break; }
+                uint64_t chunk = std::min(end, (cell + 1) * cell_bytes) - pos;
+                (b.allocated ? used : free)[cell] += chunk;
+                pos += chunk;
+            }
+        }
+        printf("\nHeap map, %llu bytes per cell ('#' allocated, '.' free, '+' mixed):\n",
+               static_cast<unsigned long long>(cell_bytes));
+        for (unsigned r = 0; r < rows; ++r)
+        {
+            std::string line;
+            for (unsigned c = 0; c < width; ++c)
+            {
+                uint64_t cell = static_cast<uint64_t>(r) * width + c;
+                line += (used[cell] == 0) ? ((free[cell] == 0) ? ' ' : '.') : ((free[cell] == 0) ? '#' : '+');
+            }
+            printf("%10llu |%s|\n", static_cast<unsigned long long>(r * width * cell_bytes), line.c_str());
+        }
+    }
+
+    bool svgMap(const Dump& dump, const char* path)
+    {
+        constexpr unsigned WIDTH = 1024, ROWS = 64, ROW_HEIGHT = 12;
+        FILE* f = fopen(path, "w");
+        if (f == nullptr)
+        {
+            fprintf(stderr, "can't create %s\n", path);
+            return false;
+        }
+        const double row_bytes = std::max(1.0, static_cast<double>(dump.header.heapSize) / ROWS);
+        fprintf(f, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%u\" height=\"%u\">\n", WIDTH, ROWS * ROW_HEIGHT);
+        fprintf(f, "<rect width=\"100%%\" height=\"100%%\" fill=\"#dddddd\"/>\n");
+        for (const Block& b : dump.blocks)
+        {
+            /* A block may wrap over several rows */
+            double pos = static_cast<double>(b.offset), end = static_cast<double>(b.offset + b.size);
+            while (pos < end)
+            {
+                double row = static_cast<double>(static_cast<uint64_t>(pos / row_bytes));
+                double row_end = std::min(end, (row + 1) * row_bytes);
+                double x = (pos - row * row_bytes) / row_bytes * WIDTH;
+                double w = std::max(0.5, (row_end - pos) / row_bytes * WIDTH);
+                fprintf(f,
+                        "<rect x=\"%.2f\" y=\"%.0f\" width=\"%.2f\" height=\"%u\" fill=\"%s\" stroke=\"#333333\" "
+                        "stroke-width=\"0.2\"><title>+%llu %llu bytes %s</title></rect>\n",
+                        x, row * ROW_HEIGHT, w, ROW_HEIGHT, b.allocated ? "#c0392b" : "#27ae60",
+                        static_cast<unsigned long long>(b.offset), static_cast<unsigned long long>(b.size),
+                        b.allocated ? "allocated" : "free");
+                pos = row_end;
+            }
+        }
+        fprintf(f, "</svg>\n");
+        fclose(f);
+        return true;
+    }
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s DUMP [--width N] [--rows N] [--svg FILE]\n", argv[0]);
+        return 1;
+    }
+    unsigned width = 64, rows = 16;
+    const char* svg = nullptr;
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        std::string key = argv[i];
+        if (key == "--width") width = std::max(1, atoi(argv[i + 1]));
+        else if (key == "--rows") rows = std::max(1, atoi(argv[i + 1]));
+        else if (key == "--svg") svg = argv[i + 1];
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    Dump dump;
+    if (!load(argv[1], dump)) { return 1; }
+    summary(dump);
+    histogram(dump, false);
+    histogram(dump, true);
+    asciiMap(dump, width, rows);
+    if ((svg != nullptr) && !svgMap(dump, svg)) { return 1; }
+    return 0;
+}
@@ -10,7 +10,7 @@ set(_UFW_UHEAP_INIT_ OFF)
 function(UHEAP_INIT TARGET)
     if(NOT _UFW_UHEAP_INIT_)
         message(STATUS "UHEAP: Heap init")
-        file(GLOB_RECURSE __L_HEAP_SRC  RELATIVE ${PROJECT_SOURCE_DIR} "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap.*" "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/uheap_allocator.h")
+        file(GLOB_RECURSE __L_HEAP_SRC  RELATIVE ${PROJECT_SOURCE_DIR} "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap.*" "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap_locks.h" "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap_placement.h" "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap_config.h" "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap_impl.h" "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap_dump.h" "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap_trace.h" "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap_trace.cpp" "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/upool.h" "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uarena.h" "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap_resource.h" "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/uheap_allocator.h")
         file(GLOB_RECURSE __L_HEAP_HOOKS_SRC  RELATIVE ${PROJECT_SOURCE_DIR} "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/_uheap_hooks.c")
         file(GLOB_RECURSE __L_HEAP_OPTIONS  RELATIVE ${PROJECT_SOURCE_DIR} "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/uheap_opt.h")
         message(STATUS "UHEAP INIT:${__L_HEAP_SRC} ${__L_HEAP_HOOKS_SRC} ${__L_HEAP_OPTIONS}")
@@ -53,6 +53,88 @@ endfunction()
      target_sources(${TARGET} PUBLIC ${__L_CINTERFACE_SRC} ${__L_MALLOC_SRC})
  endfunction()
 
+# Lock latency/throughput benchmark (header-only locks, no heap required)
+function(UHEAP_LOCK_BENCH)
+    message(STATUS "UHEAP_LOCK_BENCH invoked")
+    find_package(Threads REQUIRED)
+    add_executable(uheap_lock_bench "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/bench/uheap_lock_bench.cpp")
+    target_include_directories(uheap_lock_bench PRIVATE ${CMAKE_CURRENT_FUNCTION_LIST_DIR})
+    target_link_libraries(uheap_lock_bench PRIVATE Threads::Threads)
+endfunction()
+
+function(UHEAP_BENCH)
+    message(STATUS "UHEAP_BENCH invoked")
+    find_package(Threads REQUIRED)
+    add_executable(uheap_bench "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/bench/uheap_bench.cpp"
+                               "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap.cpp"
+                               "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/_uheap_hooks.c")
+    target_include_directories(uheap_bench PRIVATE ${CMAKE_CURRENT_FUNCTION_LIST_DIR})
+    # Heaps of the benchmark are created over a big mmap-ed region
+    target_compile_definitions(uheap_bench PRIVATE UHEAP_MAX_HEAP_SIZE=268435456)
+    target_link_libraries(uheap_bench PRIVATE Threads::Threads)
+endfunction()
+
+function(UHEAP_REPLAY)
+    message(STATUS "UHEAP_REPLAY invoked")
+    add_executable(uheap_replay "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/bench/uheap_replay.cpp"
+                                "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap.cpp"
+                                "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/_uheap_hooks.c")
+    target_include_directories(uheap_replay PRIVATE ${CMAKE_CURRENT_FUNCTION_LIST_DIR})
+    # Traces are replayed into a heap over a big mmap-ed region
+    target_compile_definitions(uheap_replay PRIVATE UHEAP_MAX_HEAP_SIZE=268435456)
+endfunction()
+
+# uheap_bench and uheap_replay built once per placement policy (uheap_bench_bestfit etc.)
+function(UHEAP_PLACEMENT_BENCH)
+    message(STATUS "UHEAP_PLACEMENT_BENCH invoked")
+    find_package(Threads REQUIRED)
+    foreach(__POLICY IN ITEMS GoodFit FirstFit NextFit BestFit AddressOrderedFit)
+        string(TOLOWER ${__POLICY} __SUFFIX)
+        add_executable(uheap_bench_${__SUFFIX} "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/bench/uheap_bench.cpp"
+                                               "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap.cpp"
+                                               "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/_uheap_hooks.c")
+        add_executable(uheap_replay_${__SUFFIX} "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/bench/uheap_replay.cpp"
+                                                "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap.cpp"
+                                                "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/_uheap_hooks.c")
+        foreach(__TARGET uheap_bench_${__SUFFIX} uheap_replay_${__SUFFIX})
+            target_include_directories(${__TARGET} PRIVATE ${CMAKE_CURRENT_FUNCTION_LIST_DIR})
+            target_compile_definitions(${__TARGET} PRIVATE UHEAP_MAX_HEAP_SIZE=268435456
+                                                           UHEAP_PLACEMENT_POLICY=::ufw::u${__POLICY})
+        endforeach()
+        target_link_libraries(uheap_bench_${__SUFFIX} PRIVATE Threads::Threads)
+    endforeach()
+endfunction()
+
+# libuheap.so for LD_PRELOAD, the global heap reserves UHEAP_PRELOAD_MAX_HEAP_SIZE bytes of address space
+set(UHEAP_PRELOAD_MAX_HEAP_SIZE 17179869184 CACHE STRING "Address space reserved by libuheap.so")
+set(UHEAP_PRELOAD_MMAP_THRESHOLD 1048576 CACHE STRING "Requests served by own mappings in libuheap.so")
+function(UHEAP_PRELOAD)
+    message(STATUS "UHEAP_PRELOAD invoked")
+    find_package(Threads REQUIRED)
+    # uheap_preload.cpp has its own hooks
+    add_library(uheap SHARED "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap_preload.cpp"
+                             "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/heap/uheap.cpp")
+    target_include_directories(uheap PRIVATE ${CMAKE_CURRENT_FUNCTION_LIST_DIR})
+    target_compile_definitions(uheap PRIVATE UHEAP_VIRTUAL_MEMORY
+                                             UHEAP_HEAP_SIZE=1048576
+                                             UHEAP_MAX_HEAP_SIZE=${UHEAP_PRELOAD_MAX_HEAP_SIZE}
+                                             UHEAP_MMAP_THRESHOLD=${UHEAP_PRELOAD_MMAP_THRESHOLD})
+    if(CMAKE_SYSTEM_NAME STREQUAL "Linux")
+        # Threads of a service sleep on the heap lock instead of spinning
+        target_compile_definitions(uheap PRIVATE UHEAP_LOCK_TYPE=::ufw::uFutexLock)
+    endif()
+    # The compiler must not turn the heap code into calls of the functions it replaces
+    target_compile_options(uheap PRIVATE -fno-builtin-malloc -fno-builtin-calloc -fno-builtin-realloc
+                                         -fno-builtin-free)
+    target_link_libraries(uheap PRIVATE Threads::Threads)
+endfunction()
+
+function(UHEAP_ANALYZER)
+    message(STATUS "UHEAP_ANALYZER invoked")
+    add_executable(uheap_analyze "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/tools/uheap_analyze.cpp")
+    target_include_directories(uheap_analyze PRIVATE ${CMAKE_CURRENT_FUNCTION_LIST_DIR})
+endfunction()
+
 # Must init heap and add wrappers to reent versions of C allocation functions
 # function(UHEAP_NEWLIB_MALLOC TARGET)
 #     message(STATUS "UHEAP_NEWLIB_MALLOC invoked")
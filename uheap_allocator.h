@@ -16,10 +16,15 @@
 #include <./heap/uheap.h>
 
 #include <cstddef>
+#include <memory>
+#include <type_traits>
 
 #define PLATFORM_MEM_VALID (ufw::uHeap::instance().getFreeBytesRemaining() > n)
-#define PLATFORM_MEM_ALLOC(size, type) ufw::uHeap::instance().allocate(size * sizeof(type))
-#define PLATFORM_MEM_DEALLOC(size, obj_ptr) ufw::uHeap::instance().deallocate(obj_ptr)
+#define PLATFORM_MEM_ALLOC(size, type) ufw::uHeap::instance().allocate_aligned(size * sizeof(type), alignof(type))
+#define PLATFORM_MEM_DEALLOC(size, obj_ptr) ufw::uHeap::instance().deallocate(obj_ptr, size * sizeof(*obj_ptr))
+#define PLATFORM_MEM_EXPAND(size, type, obj_ptr) ufw::uHeap::instance().try_expand(obj_ptr, size * sizeof(type))
+#define PLATFORM_MEM_REALLOC(size, type, obj_ptr) ufw::uHeap::instance().reallocate(obj_ptr, size * sizeof(type))
+#define PLATFORM_MEM_USABLE(type, obj_ptr) (ufw::uHeap::instance().usable_size(obj_ptr) / sizeof(type))
 static void _do_nothing(){}; /* placeholder */
 #define PLATFORM_MEM_EXCEPTION _do_nothing()
 
@@ -52,10 +57,57 @@ class uHeapAllocator
         return nullptr;
     }
 
+#ifdef __cpp_lib_allocate_at_least
+    using allocation_result = std::allocation_result<T*, size_t>;
+#else
+    /**
+     * @brief allocation_result - std::allocation_result of C++23
+     */
+    struct allocation_result
+    {
+        T* ptr;
+        size_t count;
+    };
+#endif
+
+    /**
+     * @brief allocate_at_least - allocate at least n objects and return how many fit in
+     * the block, the alignment padding and the unsplit tail of the block included
+     * (std::allocator_traits::allocate_at_least of C++23). Pass count to deallocate().
+     */
+    allocation_result allocate_at_least(size_t n) noexcept
+    {
+        T* p = allocate(n);
+        if (p == nullptr) { return {nullptr, 0}; }
+        return {p, PLATFORM_MEM_USABLE(T, p)};
+    }
+
     void deallocate(T* p, size_t n) noexcept
     {
         if (p) PLATFORM_MEM_DEALLOC(n, p);
     }
+
+    /**
+     * @brief try_expand - resize allocation of p to n objects in place (non-standard)
+     * @return true if p holds n objects now
+     */
+    bool try_expand(T* p, size_t n) noexcept
+    {
+        return (p != nullptr) && (n != 0) && PLATFORM_MEM_EXPAND(n, T, p);
+    }
+
+    /**
+     * @brief reallocate - resize allocation of p to n objects, in place if possible
+     * (non-standard). Objects are moved bytewise, so T must be trivially copyable.
+     * @return resized allocation or nullptr (p is still valid)
+     */
+    T* reallocate(T* p, size_t n) noexcept
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "reallocate moves objects bytewise");
+        if (auto r = static_cast<T*>(PLATFORM_MEM_REALLOC(n, T, p))) { return r; }
+        if (n != 0) PLATFORM_MEM_EXCEPTION;
+        return nullptr;
+    }
 };
 
 template <class T, class U>
@@ -29,6 +29,15 @@
         #define UHEAP_HEAP_SIZE (1024 * 1024)
     #endif
 
+    /**
+     * @def UHEAP_MAX_HEAP_SIZE
+     * @brief Largest memory region (in bytes) a heap instance can manage. Defines the
+     * size of the free lists index, bigger regions are truncated.
+     */
+    #ifndef UHEAP_MAX_HEAP_SIZE
+        #define UHEAP_MAX_HEAP_SIZE UHEAP_HEAP_SIZE
+    #endif
+
     /**
      * @def UHEAP_OVERRIDES_NEW
      * @brief If set to "1" overrides new/delete operators
@@ -39,12 +48,23 @@
 
     /**
      * @def UHEAP_LOCK_TYPE
-     * @brief Define your own "BasicLockable" object type
+     * @brief Define your own "BasicLockable" object type or use one of the built-in
+     * locks from heap/uheap_locks.h: ufw::uSpinLock (default), ufw::uTicketLock or
+     * ufw::uFutexLock (Linux only)
      */
+//    #define UHEAP_LOCK_TYPE ufw::uFutexLock
 //#ifdef __cplusplus
 //    #include <mutex>
 //    #define UHEAP_LOCK_TYPE std::mutex
 //#endif
+    /**
+     * @def UHEAP_PLACEMENT_POLICY
+     * @brief Free block placement policy from heap/uheap_placement.h: ufw::uGoodFit
+     * (default, O(1) TLSF search), ufw::uFirstFit, ufw::uNextFit, ufw::uBestFit
+     * (size-ordered) or ufw::uAddressOrderedFit. All but the default walk size class
+     * lists to leave less unused space.
+     */
+//    #define UHEAP_PLACEMENT_POLICY ufw::uBestFit
 /**
  * @def UHEAP_WRAPS_MALLOC
  * @brief if defined wraps standart library malloc, calloc, realloc and free.
@@ -61,6 +81,197 @@
         #endif
     #endif
 
+    /**
+     * @def UHEAP_THREAD_CACHE
+     * @brief define this option to keep per-thread bins of small blocks in front of the
+     * heap lock. Requires "thread_local" support.
+     */
+//    #define UHEAP_THREAD_CACHE
+
+    /**
+     * @def UHEAP_THREAD_CACHE_MAX_SIZE
+     * @brief Largest request (in bytes) served by the thread cache
+     */
+    #ifndef UHEAP_THREAD_CACHE_MAX_SIZE
+        #define UHEAP_THREAD_CACHE_MAX_SIZE 256
+    #endif
+
+    /**
+     * @def UHEAP_THREAD_CACHE_BATCH
+     * @brief Number of blocks moved between the thread cache and the heap at once. A bin
+     * holds up to twice this number of blocks.
+     */
+    #ifndef UHEAP_THREAD_CACHE_BATCH
+        #define UHEAP_THREAD_CACHE_BATCH 16
+    #endif
+
+    /**
+     * @def UHEAP_DEFERRED_FREE
+     * @brief define this option to make deallocate() lock-free. Freed blocks are pushed
+     * to an atomic list of the heap and returned to the free lists in bulk by the next
+     * allocation, which holds the heap lock anyway. Requires a lock with try_lock().
+     */
+//    #define UHEAP_DEFERRED_FREE
+
+    /**
+     * @def UHEAP_DEFERRED_FREE_THRESHOLD
+     * @brief Number of deferred blocks at which a freeing thread returns them itself if
+     * the heap lock is free
+     */
+    #ifndef UHEAP_DEFERRED_FREE_THRESHOLD
+        #define UHEAP_DEFERRED_FREE_THRESHOLD 64
+    #endif
+
+    /**
+     * @def UHEAP_POOL_CHUNK_SIZE
+     * @brief Default size (in bytes) of memory chunks taken by object pools from the heap
+     */
+    #ifndef UHEAP_POOL_CHUNK_SIZE
+        #define UHEAP_POOL_CHUNK_SIZE 4096
+    #endif
+
+    /**
+     * @def UHEAP_ARENA_CHUNK_SIZE
+     * @brief Default usable size (in bytes) of memory chunks taken by arenas from the heap
+     */
+    #ifndef UHEAP_ARENA_CHUNK_SIZE
+        #define UHEAP_ARENA_CHUNK_SIZE 4096
+    #endif
+
+    /**
+     * @def UHEAP_POOL_RESOURCE_MAX_SIZE
+     * @brief Biggest block (in bytes) served by pool memory resources from their slabs,
+     * bigger blocks are taken from the heap
+     */
+    #ifndef UHEAP_POOL_RESOURCE_MAX_SIZE
+        #define UHEAP_POOL_RESOURCE_MAX_SIZE 512
+    #endif
+
+    /**
+     * @def UHEAP_DEBUG_CHECKS
+     * @brief define this option to enable extra consistency checks, e.g. sized
+     * deallocation size against the block header
+     */
+//    #define UHEAP_DEBUG_CHECKS
+
+    /**
+     * @def UHEAP_STATS
+     * @brief define this option to count allocations, deallocations, request sizes and
+     * free lists search steps for uHeap::stats(). Counters are updated under the heap
+     * lock, the largest free block and free blocks count are available without it.
+     */
+//    #define UHEAP_STATS
+
+    /**
+     * @def UHEAP_TRACE
+     * @brief define this option to record allocate/deallocate/reallocate calls of all
+     * heaps into per-thread ring buffers, see uheap_trace.h and uTrace::drain()
+     */
+//    #define UHEAP_TRACE
+
+    /**
+     * @def UHEAP_TRACE_BUFFER_SIZE
+     * @brief Number of events in the ring buffer of a thread
+     */
+    #ifndef UHEAP_TRACE_BUFFER_SIZE
+        #define UHEAP_TRACE_BUFFER_SIZE 1024
+    #endif
+
+    /**
+     * @def UHEAP_TRACE_THREADS
+     * @brief Number of ring buffers, events of threads beyond it are dropped
+     */
+    #ifndef UHEAP_TRACE_THREADS
+        #define UHEAP_TRACE_THREADS 8
+    #endif
+
+    /**
+     * @def UHEAP_TRACE_CLOCK
+     * @brief Timestamp source of trace events, expands to uint64_t. Defaults to
+     * std::chrono::steady_clock nanoseconds, define it to e.g. a cycle counter on MCUs.
+     */
+
+    /**
+     * @def UHEAP_VIRTUAL_MEMORY
+     * @brief define this option to back the global heap with virtual memory (POSIX mmap)
+     * instead of the static array. UHEAP_MAX_HEAP_SIZE bytes of address space are
+     * reserved, UHEAP_HEAP_SIZE bytes are committed at start and the heap grows at its
+     * end when no free block fits. Free pages are given back with uHeap::trim() and
+     * uHeap::decay().
+     */
+//    #define UHEAP_VIRTUAL_MEMORY
+
+    /**
+     * @def UHEAP_VM_COMMIT_STEP
+     * @brief Least number of bytes committed when the heap grows
+     */
+    #ifndef UHEAP_VM_COMMIT_STEP
+        #define UHEAP_VM_COMMIT_STEP (256 * 1024)
+    #endif
+
+    /**
+     * @def UHEAP_VM_TRIM_THRESHOLD
+     * @brief Free blocks smaller than this are never trimmed, decay() waits until at
+     * least this number of bytes is freed
+     */
+    #ifndef UHEAP_VM_TRIM_THRESHOLD
+        #define UHEAP_VM_TRIM_THRESHOLD (64 * 1024)
+    #endif
+
+    /**
+     * @def UHEAP_VM_DECAY_MS
+     * @brief Time in milliseconds freed memory is kept for reuse before decay() gives
+     * it back to the OS
+     */
+    #ifndef UHEAP_VM_DECAY_MS
+        #define UHEAP_VM_DECAY_MS 1000
+    #endif
+
+    /**
+     * @def UHEAP_VM_HUGE_PAGES
+     * @brief Pages of the virtual memory backed heap: 0 - normal pages, 1 - transparent
+     * huge pages (madvise(MADV_HUGEPAGE)), 2 - explicit huge pages (MAP_HUGETLB), the
+     * whole reserve is taken from the huge pages pool at start. Unavailable huge pages
+     * fall back to transparent and then normal pages, uHeap::stats() reports the mode
+     * in use.
+     */
+    #ifndef UHEAP_VM_HUGE_PAGES
+        #define UHEAP_VM_HUGE_PAGES 0
+    #endif
+
+    /**
+     * @def UHEAP_VM_HUGE_PAGE_SIZE
+     * @brief Huge page size in bytes, also the commit and trim granularity of a heap on
+     * huge pages
+     */
+    #ifndef UHEAP_VM_HUGE_PAGE_SIZE
+        #define UHEAP_VM_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+    #endif
+
+    /**
+     * @def UHEAP_VM_PREFAULT
+     * @brief define this option to pre-fault committed memory of the virtual memory
+     * backed heap, so first touches of heap blocks don't take page faults
+     */
+//    #define UHEAP_VM_PREFAULT
+
+    /**
+     * @def UHEAP_VM_MLOCK
+     * @brief define this option to lock committed memory of the virtual memory backed
+     * heap in RAM (mlock). Locked heaps aren't trimmed, uHeap::stats() reports if
+     * locking failed (e.g. RLIMIT_MEMLOCK).
+     */
+//    #define UHEAP_VM_MLOCK
+
+    /**
+     * @def UHEAP_MMAP_THRESHOLD
+     * @brief define this option (POSIX) to serve requests of at least this number of
+     * bytes directly with mmap. Such blocks don't take heap space, they are given back
+     * to the OS on free and resized with mremap (Linux). Requests aligned to more than
+     * 16 bytes and batches are always served by the heap.
+     */
+//    #define UHEAP_MMAP_THRESHOLD (256 * 1024)
+
     /**
      * @def UHEAP_USE_ERRNO
      * @brief Premission for using POSIX Error numbers and "errno.h"